@@ -11,6 +11,7 @@
                 'src/nuclear/src/util/network/get_interfaces.cpp',
                 'src/nuclear/src/util/network/if_number_from_address.cpp',
                 'src/nuclear/src/util/network/resolve.cpp',
+                'src/nuclear/src/util/serialise/lz4.cpp',
                 'src/nuclear/src/util/serialise/xxhash.cpp'
             ],
             'cflags': [],
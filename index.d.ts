@@ -17,6 +17,8 @@
 
 /// <reference types="node" />
 
+import { Readable, Writable } from 'stream';
+
 /**
  * NUClearNet options for connecting to the network
  */
@@ -30,8 +32,135 @@ export interface NUClearNetOptions {
   /** The announce port for this network. Defaults to `7447`. */
   port?: number;
 
-  /** The MTU of the network. Used for splitting packets optimally. */
+  /**
+   * The MTU of the network. Used for splitting packets optimally, and for sizing the buffers packets are
+   * received into so larger (jumbo) frames are not truncated. Defaults to `1500`.
+   */
   mtu?: number;
+
+  /**
+   * The maximum number of received packets that are passed from the native module to JavaScript in one call.
+   * Defaults to `0`, which means no limit: every packet received since the last call is passed together.
+   */
+  maxBatchSize?: number;
+
+  /**
+   * How long in milliseconds received packets can be held back so they are passed to JavaScript in a larger batch.
+   * Defaults to `0`, which passes packets on as soon as the network has finished reading what is available.
+   */
+  batchLatency?: number;
+
+  /**
+   * The maximum number of received packets that can be waiting to be passed to JavaScript.
+   * When the queue is full `queuePolicy` decides what happens. Defaults to `0`, which means no limit.
+   */
+  maxQueueSize?: number;
+
+  /**
+   * What to do when `maxQueueSize` packets are waiting to be passed to JavaScript. Defaults to `'block'`.
+   *   - `'block'`: stop reading from the network until JavaScript catches up
+   *   - `'drop-oldest'`: drop the packet that has been waiting the longest to make room
+   *   - `'drop-newest'`: drop the packet that just arrived
+   *   - `'drop-unreliable'`: drop the packet that just arrived if it is unreliable, otherwise make room for it
+   *     by dropping the oldest unreliable packet. Reliable packets are never dropped.
+   */
+  queuePolicy?: 'block' | 'drop-oldest' | 'drop-newest' | 'drop-unreliable';
+
+  /**
+   * If `true`, the network is run on its own native thread: reading, acknowledging and retransmitting
+   * packets all happen there, and only completed packets and join/leave events are passed to JavaScript.
+   * This keeps the network responsive while the JavaScript thread is busy. Defaults to `false`.
+   */
+  networkThread?: boolean;
+
+  /**
+   * How reliable packets sent to a specific target are paced. Defaults to `'aimd'`.
+   *   - `'aimd'`: limit how many datagrams are waiting for acknowledgement with a window that grows while they
+   *     arrive and halves when they are lost, and spread them out over the round trip
+   *   - `'none'`: send every datagram at once and resend everything unacknowledged each round trip
+   * Reliable packets sent to everyone are always sent at once.
+   */
+  congestionControl?: 'aimd' | 'none';
+
+  /**
+   * Messages of at least this many bytes are compressed with LZ4 before they are sent, as long as every peer they are
+   * sent to has announced that it can decompress them. They are only sent compressed if that made them smaller.
+   * Defaults to `0`, which never compresses. Streams are never compressed.
+   * Use `compress()` to stop types that don't compress well, such as images, from being tried.
+   */
+  compressionThreshold?: number;
+
+  /**
+   * Spread untargeted messages over this many multicast groups, chosen by their type, so each node only joins the
+   * groups for the types it listens to and its network card can discard the rest. The groups count up from the
+   * announce `address`, and are only used when every peer on the network uses the same number, otherwise everything
+   * is sent to the announce group.
+   * Defaults to `0`, which doesn't use them. Only used when `address` is a multicast group.
+   * Operating systems limit how many groups can be joined (20 by default on Linux); a node that can't join a group it
+   * needs falls back to having everything sent to the announce group.
+   */
+  typeGroups?: number;
+
+  /**
+   * The largest message in bytes that is accepted from the network, so a corrupt or malicious packet can't make this
+   * node allocate an unbounded amount of memory for it. Larger messages are dropped without being acknowledged, so
+   * reliable sends of them to this node time out. Compressed messages are limited by their decompressed size.
+   * Defaults to 256MB; `0` accepts messages of any size.
+   */
+  maxMessageSize?: number;
+}
+
+/**
+ * Counters describing the state of a NUClearNet instance
+ */
+export interface NUClearNetStats {
+  /** The number of received packets waiting to be passed to JavaScript */
+  packetsQueued: number;
+
+  /** The number of received packets dropped because the queue to JavaScript was full */
+  packetsDropped: number;
+
+  /** The number of received packets that have been passed to JavaScript */
+  packetsDelivered: number;
+
+  /** The number of times a datagram was received into a buffer reused from the receive buffer pool */
+  bufferPoolHits: number;
+
+  /** The number of times the receive buffer pool was empty, so a new buffer was allocated */
+  bufferPoolMisses: number;
+
+  /** The number of buffers waiting in the receive buffer pool to be reused */
+  bufferPoolAvailable: number;
+
+  /** The number of datagrams sent on the data socket */
+  datagramsSent: number;
+
+  /** The number of system calls made to send those datagrams, fewer when they are batched or segmented by the kernel */
+  sendCalls: number;
+
+  /** The number of acks sent for reliable packets we received, several chunks arriving together share one ack */
+  acksSent: number;
+
+  /** The number of packets that were sent compressed */
+  packetsCompressed: number;
+
+  /** The number of packets that were compressed but sent as they were, as compressing didn't make them smaller */
+  packetsIncompressible: number;
+
+  /** The number of bytes the packets that were sent compressed had before they were compressed */
+  compressionInputBytes: number;
+
+  /**
+   * The number of bytes the packets that were sent compressed had after they were compressed.
+   * Divide `compressionInputBytes` by this for the compression ratio.
+   */
+  compressionOutputBytes: number;
+
+  /**
+   * The number of times a peer was left out of a message sent to it or a reliable message sent to everyone, as it
+   * told us it doesn't listen to the message's type
+   */
+  peersSkipped: number;
 }
 
 /**
@@ -39,12 +168,16 @@ export interface NUClearNetOptions {
  */
 export interface NUClearNetSend {
   /**
-   * The type of the message to send: either a string that will be hashed,
-   * or a Buffer with the 64 bit hash.
+   * The type of the message to send: either a string that will be hashed, a Buffer or BigInt
+   * with the 64 bit hash, or a handle from `NUClearNet.type()`.
+   * Use a handle or BigInt when sending often to avoid hashing the type on every send.
    */
-  type: string | Buffer;
+  type: string | Buffer | bigint | NUClearType;
 
-  /** The data to send */
+  /**
+   * The data to send. The Buffer is not copied: for reliable sends it is held until every
+   * target has acknowledged it, so it must not be modified until then.
+   */
   payload: Buffer;
 
   /**
@@ -58,6 +191,75 @@ export interface NUClearNetSend {
    * which handles retransmissions.
    */
   reliable?: boolean;
+
+  /**
+   * If `true`, `send()` returns a Promise that resolves once every target has acknowledged the packet.
+   * It rejects if the packet times out or a target leaves first. Only reliable packets can be acknowledged.
+   */
+  acknowledge?: boolean;
+
+  /**
+   * How long in milliseconds to wait for every target to acknowledge the packet when `acknowledge` is set.
+   * Defaults to `0`, which waits until every target acknowledges the packet or leaves.
+   */
+  timeout?: number;
+}
+
+/**
+ * Options for sending a message whose payload is written a piece at a time with `sendStream()`
+ */
+export interface NUClearNetSendStream {
+  /** The type of the message to send, the same as `NUClearNetSend.type` */
+  type: string | Buffer | bigint | NUClearType;
+
+  /** The target to send the message to. Streams always have a target. */
+  target: string;
+
+  /**
+   * How many bytes will be written to the stream. Every datagram says how large the message is, so this is
+   * needed before anything can be sent, and ending the stream before this many bytes are written is an error.
+   */
+  length: number;
+
+  /**
+   * How long in milliseconds to wait for the target to acknowledge the whole message, counted from when the
+   * stream is opened. Defaults to `0`, which waits until the target acknowledges it or leaves.
+   */
+  timeout?: number;
+}
+
+/**
+ * A target that acknowledged a packet sent with `acknowledge: true`
+ */
+export interface NUClearNetAck {
+  /** The name of the target that acknowledged the packet */
+  name: string;
+
+  /** How long in milliseconds it took from when the packet was sent to when it was fully acknowledged */
+  latency: number;
+}
+
+/**
+ * The error a packet sent with `acknowledge: true` rejects with when it was not delivered to every target
+ */
+export interface NUClearNetAckError extends Error {
+  /** The targets that did acknowledge the packet */
+  acknowledged: NUClearNetAck[];
+}
+
+/**
+ * A message type with its hash calculated ahead of time. Created with `NUClearNet.type()`, and can be
+ * used in place of the type name for `send()`, `on()` and `removeListener()`.
+ */
+export declare class NUClearType {
+  /** The name of the type */
+  readonly name: string;
+
+  /** The 64 bit hash of the type */
+  readonly hash: bigint;
+
+  /** Returns the name of the type, so events for a handle and its name are the same */
+  public toString(): string;
 }
 
 /**
@@ -84,10 +286,13 @@ export interface NUClearNetPacket {
   /** The peer the packet was sent from */
   peer: NUClearNetPeer;
 
-  /** The hash code of the packet's type */
+  /**
+   * The hash code of the packet's type.
+   * The same Buffer instance is shared by every packet of this type, so it must not be modified.
+   */
   hash: Buffer;
 
-  /** The data that was sent from the peer */
+  /** The data that was sent from the peer. This Buffer owns its memory and is not shared. */
   payload: Buffer;
 
   /**
@@ -118,6 +323,29 @@ export interface NUClearNetMaybeTypedPacket extends NUClearNetPacket {
   type: string | undefined;
 }
 
+/**
+ * A message received on a type listened to with `onStream()`, whose payload is read as it arrives
+ */
+export interface NUClearNetStreamPacket {
+  /** The peer the message was sent from */
+  peer: NUClearNetPeer;
+
+  /** The hash code of the message's type, shared the same as `NUClearNetPacket.hash` */
+  hash: Buffer;
+
+  /** The type that was provided to `onStream()` */
+  type: string;
+
+  /** If the peer sent the message with reliable transmission */
+  reliable: boolean;
+
+  /**
+   * The data sent from the peer, in order. Reliable messages of more than one datagram are pushed a piece at a
+   * time as they arrive, anything else is pushed whole. It is destroyed with an error if the peer leaves first.
+   */
+  payload: Readable;
+}
+
 /**
  * Represents a NUClearNet network client.
  *
@@ -141,20 +369,29 @@ export declare class NUClearNet {
   public on(event: 'nuclear_packet', callback: (packet: NUClearNetMaybeTypedPacket) => void): this;
 
   /** Emitted when the given packet is received */
-  public on(event: string, callback: (packet: NUClearNetTypedPacket) => void): this;
+  public on(event: string | NUClearType, callback: (packet: NUClearNetTypedPacket) => void): this;
 
   /**
    * Hash the provided string using the NUClearNet hashing method.
    * These hashes will be identical to those used by NUClear
    */
-  public hash(data: string): Buffer;
+  public hash(data: string | bigint): Buffer;
+
+  /**
+   * Create a handle for the given type, with its hash calculated once up front.
+   * The handle can be used in place of the type name for `send()`, `on()` and `removeListener()`.
+   */
+  public type(name: string): NUClearType;
+
+  /** Get the current counters for this instance. */
+  public stats(): NUClearNetStats;
 
   /**
    * Stop listening for the given type.
    * Note that after removing the last listener for a type, the type will revert to
    * being an undefined type for `NUClearNetMaybeTypedPacket`.
    */
-  public removeListener(event: string, listener: Function): this;
+  public removeListener(event: string | NUClearType, listener: Function): this;
 
   /**
    * Connect this instance to the NUclear network.
@@ -178,6 +415,42 @@ export declare class NUClearNet {
   /**
    * Send the given packet over the NUClear network.
    * Will throw if the network is not connected.
+   * Peers tell each other which types they listen to, so peers that don't listen to the packet's type are left out.
+   * With `acknowledge: true`, returns a Promise of the targets that acknowledged the packet. If the packet
+   * is not delivered to every target that listens to its type, the Promise rejects with an `NUClearNetAckError`.
    */
+  public send(options: NUClearNetSend & { acknowledge: true }): Promise<NUClearNetAck[]>;
   public send(options: NUClearNetSend): void;
+
+  /**
+   * Send many packets over the NUClear network in a single call, which is much cheaper than calling
+   * `send()` for each of them. Will throw if the network is not connected.
+   * Returns an entry for each packet: an `Error` if that packet could not be sent, otherwise `undefined`.
+   */
+  public sendBatch(messages: NUClearNetSend[]): (Error | undefined)[];
+
+  /**
+   * Send a reliable message by writing its payload a piece at a time, without ever holding all of it in memory.
+   * Each write is copied and sent as the target's congestion window allows, and the Writable pushes back once
+   * the data waiting to be acknowledged reaches about two windows. The Writable finishes once the target has
+   * acknowledged the whole message, and errors if it can't be delivered. Destroying it abandons the message.
+   * Will throw if the network is not connected or the target is unknown.
+   */
+  public sendStream(options: NUClearNetSendStream): Writable;
+
+  /**
+   * Receive messages of the given type as streams rather than as events, so large messages can be read as they
+   * arrive without waiting for all of them. Packets of this type are no longer emitted to `on()` listeners.
+   * Calling it again for the same type replaces the handler.
+   */
+  public onStream(type: string | NUClearType, handler: (packet: NUClearNetStreamPacket) => void): this;
+
+  /** Stop receiving the given type as streams, going back to emitting whole packets to `on()` listeners. */
+  public offStream(type: string | NUClearType): this;
+
+  /**
+   * Choose whether messages of the given type can be compressed when they are larger than `compressionThreshold`.
+   * Every type can be compressed unless this is called with `false`.
+   */
+  public compress(type: string | NUClearType, enabled: boolean): this;
 }
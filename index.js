@@ -19,6 +19,27 @@
 
 const { NetworkBinding } = require('bindings')('nuclearnet');
 const { EventEmitter } = require('events');
+const { Readable, Writable } = require('stream');
+
+// The number of array entries each packet takes up in a batch from the native side
+const PACKET_FIELDS = 9;
+
+// The number of array entries each message takes up in a batch sent to the native side
+const SEND_FIELDS = 4;
+
+// A message type with its hash calculated ahead of time, so it can be used for sending and listening without rehashing
+class NUClearType {
+  constructor(name, hash) {
+    this.name = name;
+    this.hash = hash;
+    Object.freeze(this);
+  }
+
+  // Event listeners are stored by name, so a handle and its name are the same event
+  toString() {
+    return this.name;
+  }
+}
 
 class NUClearNet extends EventEmitter {
   constructor() {
@@ -26,11 +47,13 @@ class NUClearNet extends EventEmitter {
 
     // Create a new network object
     this._net = new NetworkBinding();
-    this._callbackMap = {};
     this._active = false;
-    this._waiting = 0;
     this._destroyed = false;
 
+    // The handlers for types that are received as streams, and the streams that are still arriving
+    this._streamHandlers = new Map();
+    this._streams = new Map();
+
     // Stores the connect() options
     this.options = {};
 
@@ -38,7 +61,10 @@ class NUClearNet extends EventEmitter {
     this.on('newListener', (event) => {
       this.assertNotDestroyed();
 
-      if (
+      if (event === 'nuclear_packet' && this.listenerCount(event) === 0) {
+        // Someone wants every packet regardless of type
+        this._net.forwardAll(true);
+      } else if (
         event !== 'nuclear_join' &&
         event !== 'nuclear_leave' &&
         event !== 'nuclear_packet' &&
@@ -46,25 +72,29 @@ class NUClearNet extends EventEmitter {
         event !== 'removeListener' &&
         this.listenerCount(event) === 0
       ) {
-        const hash = this._net.hash(event);
-        this._callbackMap[hash] = event;
+        if (event instanceof NUClearType) {
+          this._net.subscribe(event.name, event.hash);
+        } else {
+          this._net.subscribe(event);
+        }
       }
     });
 
     // We are no longer listening to this type
     this.on('removeListener', (event) => {
-      // If we are no longer listening to this type
-      if (
+      if (event === 'nuclear_packet' && this.listenerCount(event) === 0) {
+        // Go back to only receiving the types we are listening to
+        this._net.forwardAll(false);
+      } else if (
         event !== 'nuclear_join' &&
         event !== 'nuclear_leave' &&
         event !== 'nuclear_packet' &&
         event !== 'newListener' &&
         event !== 'removeListener' &&
-        this.listenerCount(event) === 0
+        this.listenerCount(event) === 0 &&
+        !this._streamHandlers.has(String(event))
       ) {
-        // Get our hash and delete it
-        const hash = this._net.hash(event);
-        delete this._callbackMap[hash];
+        this._net.unsubscribe(event instanceof NUClearType ? event.hash : event);
       }
     });
 
@@ -72,31 +102,67 @@ class NUClearNet extends EventEmitter {
     this._net.onPacket(this._onPacket.bind(this));
     this._net.onJoin(this._onJoin.bind(this));
     this._net.onLeave(this._onLeave.bind(this));
-    this._net.onWait(this._onWait.bind(this));
   }
 
-  _onPacket(name, address, port, reliable, hash, payload) {
-    const eventName = this._callbackMap[hash];
+  _onPacket(packets) {
+    // Packets are delivered in batches, flattened into one array with PACKET_FIELDS entries per packet
+    for (let i = 0; i < packets.length; i += PACKET_FIELDS) {
+      const hash = packets[i + 4];
+      const eventName = packets[i + 6];
+      const stream = packets[i + 7];
+
+      // Construct our packet
+      const packet = {
+        peer: {
+          name: packets[i],
+          address: packets[i + 1],
+          port: packets[i + 2],
+        },
+        payload: packets[i + 5],
+        type: eventName,
+        hash: hash,
+        reliable: packets[i + 3],
+      };
+
+      // Types received as streams go to their handler rather than being emitted
+      if (stream !== undefined || this._streamHandlers.has(eventName)) {
+        this._onStreamPiece(packet, stream, stream === undefined || packets[i + 8]);
+        continue;
+      }
+
+      // Emit via nuclear_packet for people listening to everything
+      this.emit('nuclear_packet', packet);
+
+      // If someone was listening to this send it to them specifically too
+      if (eventName !== undefined) {
+        this.emit(eventName, packet);
+      }
+    }
+  }
+
+  _onStreamPiece(packet, stream, end) {
+    // Whole packets of a streamed type arrive as a stream with a single piece
+    const key = stream === undefined ? undefined : `${packet.peer.address}:${packet.peer.port}:${stream}`;
+    let readable = key === undefined ? undefined : this._streams.get(key);
 
-    // Construct our packet
-    const packet = {
-      peer: {
-        name: name,
-        address: address,
-        port: port,
-      },
-      payload: payload,
-      type: eventName,
-      hash: hash,
-      reliable: reliable,
-    };
-
-    // Emit via nuclear_packet for people listening to everything
-    this.emit('nuclear_packet', packet);
-
-    // If someone was listening to this send it to them specifically too
-    if (eventName !== undefined) {
-      this.emit(eventName, packet);
+    // The first piece of a packet starts a new stream for the handler to read from
+    if (readable === undefined) {
+      const handler = this._streamHandlers.get(packet.type);
+      if (handler === undefined) {
+        return;
+      }
+
+      readable = new Readable({ read() {} });
+      if (!end) {
+        this._streams.set(key, readable);
+      }
+      handler({ ...packet, payload: readable });
+    }
+
+    readable.push(packet.payload);
+    if (end) {
+      readable.push(null);
+      this._streams.delete(key);
     }
   }
 
@@ -109,6 +175,15 @@ class NUClearNet extends EventEmitter {
   }
 
   _onLeave(name, address, port) {
+    // Anything they were still streaming to us will never finish
+    const prefix = `${address}:${port}:`;
+    for (const [key, readable] of this._streams) {
+      if (key.startsWith(prefix)) {
+        this._streams.delete(key);
+        readable.destroy(new Error(`${name} left before the stream finished`));
+      }
+    }
+
     this.emit('nuclear_leave', {
       name: name,
       address: address,
@@ -116,28 +191,19 @@ class NUClearNet extends EventEmitter {
     });
   }
 
-  _onWait(duration) {
-    ++this._waiting;
-
-    setTimeout(() => {
-      --this._waiting;
-
-      // Only process if we're active
-      if (this._active) {
-        this._net.process();
-      }
+  hash(data) {
+    this.assertNotDestroyed();
+    return this._net.hash(data);
+  }
 
-      // Sometimes due to weird timing artifacts we run out of these
-      // Restart in 100ms!
-      if (this._active && this._waiting === 0) {
-        this._onWait(100);
-      }
-    }, duration);
+  type(name) {
+    this.assertNotDestroyed();
+    return new NUClearType(name, this._net.typeHash(name));
   }
 
-  hash(data) {
+  stats() {
     this.assertNotDestroyed();
-    return this._net.hash(data);
+    return this._net.stats();
   }
 
   connect(options) {
@@ -154,6 +220,17 @@ class NUClearNet extends EventEmitter {
 
     // Connect to the network
     this._active = true;
+    this._net.configure({
+      maxBatchSize: options.maxBatchSize,
+      batchLatency: options.batchLatency,
+      maxQueueSize: options.maxQueueSize,
+      queuePolicy: options.queuePolicy,
+      networkThread: options.networkThread,
+      congestionControl: options.congestionControl,
+      compressionThreshold: options.compressionThreshold,
+      typeGroups: options.typeGroups,
+      maxMessageSize: options.maxMessageSize,
+    });
     this._net.reset(name, address, port, mtu);
 
     // Run our first "process" to kick things off
@@ -173,15 +250,138 @@ class NUClearNet extends EventEmitter {
     if (!this._active) {
       throw new Error('The network is not currently connected');
     } else {
-      this._net.send(
-        options.type,
+      return this._net.send(
+        options.type instanceof NUClearType ? options.type.hash : options.type,
         options.payload,
         options.target,
-        options.reliable !== undefined ? options.reliable : false
+        options.reliable !== undefined ? options.reliable : false,
+        // Passing a timeout asks for a promise of when every target has acknowledged the packet
+        options.acknowledge ? options.timeout || 0 : undefined
       );
     }
   }
 
+  sendBatch(messages) {
+    this.assertNotDestroyed();
+
+    if (!this._active) {
+      throw new Error('The network is not currently connected');
+    }
+
+    // Flatten the messages into one array so they can all be sent in a single native call
+    const flat = new Array(messages.length * SEND_FIELDS);
+    for (let i = 0; i < messages.length; i++) {
+      const options = messages[i];
+      const o = i * SEND_FIELDS;
+
+      flat[o] = options.type instanceof NUClearType ? options.type.hash : options.type;
+      flat[o + 1] = options.payload;
+      flat[o + 2] = options.target;
+      flat[o + 3] = options.reliable !== undefined ? options.reliable : false;
+    }
+
+    // Errors are reported for each message rather than thrown, so one bad message doesn't stop the others
+    return this._net.sendBatch(flat).map((error) => (error === undefined ? undefined : new Error(error)));
+  }
+
+  sendStream(options) {
+    this.assertNotDestroyed();
+
+    if (!this._active) {
+      throw new Error('The network is not currently connected');
+    }
+
+    const net = this._net;
+    const length = options.length;
+    const { packetId, sequence, delivered } = net.openStream(
+      options.type instanceof NUClearType ? options.type.hash : options.type,
+      options.target,
+      length,
+      options.timeout || 0
+    );
+
+    let written = 0;
+    let finished = false;
+    const writable = new Writable({
+      write(chunk, encoding, callback) {
+        try {
+          // The network copies what we write, so we only have to wait when it is too far ahead of the targets
+          written += chunk.length;
+          const ready = net.writeStream(packetId, sequence, chunk);
+          if (ready === undefined) {
+            callback();
+          } else {
+            ready.then(() => callback());
+          }
+        } catch (err) {
+          callback(err);
+        }
+      },
+      final(callback) {
+        if (written < length) {
+          callback(new Error(`The stream ended after ${written} of its ${length} bytes were written`));
+        } else {
+          // We are only finished once every target has the whole message
+          delivered.then(() => {
+            finished = true;
+            callback();
+          }, callback);
+        }
+      },
+      destroy(err, callback) {
+        if (!finished) {
+          net.abortStream(packetId, sequence, err ? err.message : 'The stream was destroyed before it finished');
+        }
+        callback(err);
+      },
+    });
+
+    // If the message can't be delivered there is no point writing any more of it
+    delivered.catch((err) => writable.destroy(err));
+
+    return writable;
+  }
+
+  onStream(type, handler) {
+    this.assertNotDestroyed();
+
+    // Subscribe to the type, but have its packets given to us a piece at a time
+    const name = String(type);
+    this._streamHandlers.set(name, handler);
+    if (type instanceof NUClearType) {
+      this._net.subscribe(type.name, type.hash);
+      this._net.streamType(type.hash, true);
+    } else {
+      this._net.subscribe(type);
+      this._net.streamType(type, true);
+    }
+    return this;
+  }
+
+  offStream(type) {
+    this.assertNotDestroyed();
+
+    const name = String(type);
+    if (!this._streamHandlers.delete(name)) {
+      return this;
+    }
+
+    // Go back to receiving whole packets, or nothing if nobody else is listening
+    const key = type instanceof NUClearType ? type.hash : type;
+    this._net.streamType(key, false);
+    if (this.listenerCount(name) === 0) {
+      this._net.unsubscribe(key);
+    }
+    return this;
+  }
+
+  compress(type, enabled) {
+    this.assertNotDestroyed();
+
+    this._net.compressType(type instanceof NUClearType ? type.hash : type, enabled);
+    return this;
+  }
+
   destroy() {
     if (this._active) {
       this.disconnect();
@@ -189,9 +389,12 @@ class NUClearNet extends EventEmitter {
 
     this.removeAllListeners();
 
-    for (const prop in this._callbackMap) {
-      delete this._callbackMap[prop];
+    // Streams that were still arriving never will now
+    for (const readable of this._streams.values()) {
+      readable.destroy(new Error('The network was destroyed before the stream finished'));
     }
+    this._streams.clear();
+    this._streamHandlers.clear();
 
     this._net.destroy();
 
@@ -216,3 +419,4 @@ class NUClearNet extends EventEmitter {
 }
 
 exports.NUClearNet = NUClearNet;
+exports.NUClearType = NUClearType;
@@ -17,6 +17,11 @@
 
 #include "NetworkBinding.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
 #include "NetworkListener.hpp"
 #include "nuclear/src/util/serialise/xxhash.hpp"
 
@@ -25,64 +30,361 @@ namespace NUClear {
 using extension::network::NUClearNetwork;
 using util::serialise::xxhash64;
 
-NetworkBinding::NetworkBinding(const Napi::CallbackInfo& info) : Napi::ObjectWrap<NetworkBinding>(info) {}
+NetworkBinding::NetworkBinding(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<NetworkBinding>(info), main_thread(std::this_thread::get_id()) {
+    Napi::Env env = info.Env();
+
+    this->net.set_next_event_callback(
+        [this](const std::chrono::steady_clock::time_point& t) { ScheduleProcess(t); });
+
+    // Every type can be compressed unless javascript says otherwise
+    this->net.set_compression_filter([this](const uint64_t& hash) {
+        const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+        return uncompressed_types.count(hash) == 0;
+    });
+
+    // Make the timer we use to process the network when it next needs attention
+    uv_loop_t* loop = nullptr;
+    if (napi_get_uv_event_loop(env, &loop) != napi_ok) {
+        Napi::Error::New(env, "Unable to get the event loop for the network timer").ThrowAsJavaScriptException();
+        return;
+    }
+    process_timer = new uv_timer_t();
+    uv_timer_init(loop, process_timer);
+    process_timer->data = this;
+}
+
+NetworkBinding::~NetworkBinding() {
+    CloseTimer();
+    ReleaseOrphanedPayloads();
+}
 
 Napi::Value NetworkBinding::Hash(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
+    uint64_t hash = 0;
+
     if (info.Length() > 0 && info[0].IsString()) {
         // Calculate hash
         std::string s = info[0].As<Napi::String>().Utf8Value();
-        uint64_t hash = xxhash64(s.c_str(), s.size(), 0x4e55436c);
+        hash          = xxhash64(s.c_str(), s.size(), 0x4e55436c);
+    }
+    // A BigInt is already a hash, so just convert it
+    else if (info.Length() > 0 && info[0].IsBigInt()) {
+        bool lossless = false;
+        hash          = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+        if (!lossless) {
+            Napi::TypeError::New(env, "Invalid input for hash(): BigInt does not fit in 64 bits")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    else {
+        Napi::TypeError::New(env, "Invalid input for hash(): expected a string or BigInt")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-        // Return hash
-        return Napi::Buffer<char>::Copy(env, reinterpret_cast<const char*>(&hash), sizeof(uint64_t)).As<Napi::Value>();
+    // Return hash
+    return Napi::Buffer<char>::Copy(env, reinterpret_cast<const char*>(&hash), sizeof(uint64_t)).As<Napi::Value>();
+}
+
+Napi::Value NetworkBinding::TypeHash(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && info[0].IsString()) {
+        // Calculate hash and return it as a BigInt so it can be passed straight back without any conversion
+        std::string s = info[0].As<Napi::String>().Utf8Value();
+        return Napi::BigInt::New(env, xxhash64(s.c_str(), s.size(), 0x4e55436c));
     }
     else {
-        Napi::TypeError::New(env, "Invalid input for hash(): expected a string").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Invalid input for typeHash(): expected a string").ThrowAsJavaScriptException();
         return env.Null();
     }
 }
 
-void NetworkBinding::Send(const Napi::CallbackInfo& info) {
+Napi::Value NetworkBinding::Send(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 4) {
         Napi::TypeError::New(env, "Expected 4 arguments, got fewer").ThrowAsJavaScriptException();
-        return;
+        return env.Undefined();
     }
 
-    const Napi::Value& arg_hash     = info[0];
-    const Napi::Value& arg_payload  = info[1];
-    const Napi::Value& arg_target   = info[2];
-    const Napi::Value& arg_reliable = info[3];
+    NUClearNetwork::BatchMessage message;
+    const std::string error = ReadMessage(info[0], info[1], info[2], info[3], message);
+    if (!error.empty()) {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
 
-    uint64_t hash = 0;
-    std::vector<uint8_t> payload;
-    std::string target = "";
-    bool reliable      = false;
+    // If we are given a timeout the caller wants a promise for when every target has acknowledged the packet
+    std::shared_ptr<Napi::Promise::Deferred> deferred;
+    NUClearNetwork::SendCallback on_complete;
+    std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::zero();
+    if (info.Length() > 4 && info[4].IsNumber()) {
+        if (!message.reliable) {
+            Napi::TypeError::New(env, "Invalid `acknowledge` option for send(): only reliable packets are acknowledged")
+                .ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
 
-    // Read reliability information
-    if (arg_reliable.IsBoolean()) {
-        reliable = arg_reliable.As<Napi::Boolean>().Value();
+        // Anything that isn't a positive finite number of milliseconds means wait forever
+        const double ms = info[4].As<Napi::Number>().DoubleValue();
+        if (std::isfinite(ms) && ms > 0) {
+            timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(ms));
+        }
+
+        deferred    = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+        on_complete = [this, deferred](const NUClearNetwork::SendResult& result) {
+            // Once destroyed there is nobody left to tell
+            if (destroyed) {
+                return;
+            }
+            on_packet.BlockingCall([deferred, result](Napi::Env env, Napi::Function /*js_callback*/) {
+                SettleSend(env, *deferred, result);
+            });
+        };
+    }
+
+    // Perform the send
+    try {
+        this->net.send(message.hash,
+                       std::move(message.payload),
+                       message.length,
+                       message.target,
+                       message.reliable,
+                       std::move(on_complete),
+                       timeout);
+    }
+    catch (const std::exception& ex) {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return deferred ? deferred->Promise().As<Napi::Value>() : env.Undefined();
+}
+
+void NetworkBinding::SettleSend(const Napi::Env& env,
+                                const Napi::Promise::Deferred& deferred,
+                                const NUClearNetwork::SendResult& result) {
+
+    // How long each target took to acknowledge the packet
+    Napi::Array acknowledged = Napi::Array::New(env, result.latency.size());
+    for (uint32_t i = 0; i < result.latency.size(); ++i) {
+        const auto& l = result.latency[i];
+
+        Napi::Object ack = Napi::Object::New(env);
+        ack.Set("name", Napi::String::New(env, l.first));
+        ack.Set("latency", Napi::Number::New(env, std::chrono::duration<double, std::milli>(l.second).count()));
+        acknowledged.Set(i, ack);
+    }
+
+    if (result.delivered) {
+        deferred.Resolve(acknowledged);
     }
     else {
-        Napi::TypeError::New(env, "Invalid `reliable` option for send(): expected a boolean")
+        // Let the caller know who did get it, it may be enough for them
+        Napi::Error error = Napi::Error::New(env, result.error);
+        error.Set("acknowledged", acknowledged);
+        deferred.Reject(error.Value());
+    }
+}
+
+Napi::Value NetworkBinding::SendBatch(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Invalid input for sendBatch(): expected an array").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // Messages are flattened into a single array, with each message taking up SEND_FIELDS consecutive entries
+    Napi::Array in       = info[0].As<Napi::Array>();
+    const uint32_t count = in.Length() / SEND_FIELDS;
+
+    std::vector<std::string> errors(count);
+    std::vector<NUClearNetwork::BatchMessage> messages;
+    std::vector<uint32_t> indices;
+    messages.reserve(count);
+    indices.reserve(count);
+
+    // Read every message, any that are invalid are reported and skipped rather than failing the whole batch
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t o = i * SEND_FIELDS;
+        NUClearNetwork::BatchMessage message;
+        errors[i] = ReadMessage(in.Get(o), in.Get(o + 1), in.Get(o + 2), in.Get(o + 3), message);
+        if (errors[i].empty()) {
+            messages.push_back(std::move(message));
+            indices.push_back(i);
+        }
+    }
+
+    // Perform the send
+    try {
+        const std::vector<std::string> sent = this->net.send_batch(messages);
+        for (size_t i = 0; i < sent.size(); ++i) {
+            errors[indices[i]] = sent[i];
+        }
+    }
+    catch (const std::exception& ex) {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // Report the error for each message, or undefined if it was sent
+    Napi::Array out = Napi::Array::New(env, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        out.Set(i, errors[i].empty() ? env.Undefined() : Napi::String::New(env, errors[i]));
+    }
+    return out;
+}
+
+Napi::Value NetworkBinding::OpenStream(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 4) {
+        Napi::TypeError::New(env, "Expected 4 arguments, got fewer").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    uint64_t hash           = 0;
+    const std::string error = ReadHash(info[0], "sendStream()", hash);
+    if (!error.empty()) {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!info[1].IsString()) {
+        Napi::TypeError::New(env, "Invalid `target` option for sendStream(): expected a string")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    // The network decides how large a message can be, here we only make sure it is a whole number of bytes
+    const double length = info[2].IsNumber() ? info[2].As<Napi::Number>().DoubleValue() : -1;
+    if (!(length >= 0 && length <= 9007199254740991.0 && std::floor(length) == length)) {
+        Napi::TypeError::New(env, "Invalid `length` option for sendStream(): expected a whole number of bytes")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Anything that isn't a positive finite number of milliseconds means wait forever
+    std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::zero();
+    const double ms                             = info[3].IsNumber() ? info[3].As<Napi::Number>().DoubleValue() : 0;
+    if (std::isfinite(ms) && ms > 0) {
+        timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(ms));
+    }
+
+    // Streams always say when they have been delivered, it is when the writable finishes
+    auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+    auto on_complete = [this, deferred](const NUClearNetwork::SendResult& result) {
+        // Once destroyed there is nobody left to tell
+        if (destroyed) {
+            return;
+        }
+        on_packet.BlockingCall([deferred, result](Napi::Env env, Napi::Function /*js_callback*/) {
+            SettleSend(env, *deferred, result);
+        });
+    };
+
+    NUClearNetwork::StreamId stream;
+    try {
+        stream = this->net.open_stream(hash,
+                                       size_t(length),
+                                       info[1].As<Napi::String>().Utf8Value(),
+                                       std::move(on_complete),
+                                       timeout);
+    }
+    catch (const std::exception& ex) {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Object out = Napi::Object::New(env);
+    out.Set("packetId", Napi::Number::New(env, stream.packet_id));
+    out.Set("sequence", Napi::Number::New(env, double(stream.sequence)));
+    out.Set("delivered", deferred->Promise());
+    return out;
+}
+
+Napi::Value NetworkBinding::WriteStream(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsTypedArray()) {
+        Napi::TypeError::New(env, "Invalid input for writeStream(): expected a stream id and a Buffer")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    NUClearNetwork::StreamId stream;
+    stream.packet_id = info[0].As<Napi::Number>().Uint32Value();
+    stream.sequence  = uint64_t(info[1].As<Napi::Number>().DoubleValue());
+
+    Napi::TypedArray typed_array = info[2].As<Napi::TypedArray>();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(typed_array.ArrayBuffer().Data()) + typed_array.ByteOffset();
+
+    // If the writer has to wait it is given a promise for when it can carry on
+    auto deferred = std::make_shared<Napi::Promise::Deferred>(Napi::Promise::Deferred::New(env));
+    auto on_ready = [this, deferred]() {
+        // Once destroyed there is nobody left to tell
+        if (destroyed) {
+            return;
+        }
+        on_packet.BlockingCall([deferred](Napi::Env env, Napi::Function /*js_callback*/) {
+            deferred->Resolve(env.Undefined());
+        });
+    };
+
+    try {
+        if (this->net.write_stream(stream, data, typed_array.ByteLength(), std::move(on_ready))) {
+            return env.Undefined();
+        }
+    }
+    catch (const std::exception& ex) {
+        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return deferred->Promise();
+}
+
+void NetworkBinding::AbortStream(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsString()) {
+        Napi::TypeError::New(env, "Invalid input for abortStream(): expected a stream id and a reason")
             .ThrowAsJavaScriptException();
         return;
     }
 
+    NUClearNetwork::StreamId stream;
+    stream.packet_id = info[0].As<Napi::Number>().Uint32Value();
+    stream.sequence  = uint64_t(info[1].As<Napi::Number>().DoubleValue());
+    this->net.abort_stream(stream, info[2].As<Napi::String>().Utf8Value());
+}
+
+std::string NetworkBinding::ReadMessage(const Napi::Value& arg_hash,
+                                        const Napi::Value& arg_payload,
+                                        const Napi::Value& arg_target,
+                                        const Napi::Value& arg_reliable,
+                                        NUClearNetwork::BatchMessage& message) {
+    // Read reliability information
+    if (arg_reliable.IsBoolean()) {
+        message.reliable = arg_reliable.As<Napi::Boolean>().Value();
+    }
+    else {
+        return "Invalid `reliable` option for send(): expected a boolean";
+    }
+
     // Read target information: if we have a string, use it as the target
     if (arg_target.IsString()) {
-        target = arg_target.As<Napi::String>().Utf8Value();
+        message.target = arg_target.As<Napi::String>().Utf8Value();
     }
     // Otherwise, we accept null and undefined to mean everybody
     else if (!arg_target.IsUndefined() && !arg_target.IsNull()) {
-        Napi::TypeError::New(
-            env,
-            "Invalid `target` option for send(): expected a string (for targeted), or null/undefined (for untargeted)")
-            .ThrowAsJavaScriptException();
-        return;
+        return "Invalid `target` option for send(): expected a string (for targeted), or null/undefined (for "
+               "untargeted)";
     }
 
     // Read the data information
@@ -90,18 +392,31 @@ void NetworkBinding::Send(const Napi::CallbackInfo& info) {
         Napi::TypedArray typed_array = arg_payload.As<Napi::TypedArray>();
         Napi::ArrayBuffer buffer     = typed_array.ArrayBuffer();
 
-        char* data  = reinterpret_cast<char*>(buffer.Data());
-        char* start = data + typed_array.ByteOffset();
-        char* end   = start + typed_array.ByteLength();
+        const uint8_t* data  = reinterpret_cast<const uint8_t*>(buffer.Data());
+        const uint8_t* start = data + typed_array.ByteOffset();
+        message.length       = typed_array.ByteLength();
 
-        payload.insert(payload.begin(), start, end);
+        // Reliable sends hold on to the payload until every target has acknowledged it, so rather than copying it
+        // we keep the TypedArray alive with a reference that is released when the network is done with the data
+        if (message.reliable) {
+            auto* ref       = new Napi::Reference<Napi::TypedArray>(Napi::Persistent(typed_array));
+            message.payload = std::shared_ptr<const uint8_t>(
+                start,
+                [this, ref](const uint8_t* /*data*/) { ReleasePayload(ref); });
+        }
+        // Unreliable sends are finished with the data before send returns, so we only need to point at it
+        else {
+            message.payload = std::shared_ptr<const uint8_t>(std::shared_ptr<const uint8_t>(), start);
+        }
     }
     else {
-        Napi::TypeError::New(env, "Invalid `payload` option for send(): expected a Buffer")
-            .ThrowAsJavaScriptException();
-        return;
+        return "Invalid `payload` option for send(): expected a Buffer";
     }
 
+    return ReadHash(arg_hash, "send()", message.hash);
+}
+
+std::string NetworkBinding::ReadHash(const Napi::Value& arg_hash, const std::string& function, uint64_t& hash) {
     // If we have a string, apply XXHash to get the hash
     if (arg_hash.IsString()) {
         std::string s = arg_hash.As<Napi::String>().Utf8Value();
@@ -120,24 +435,22 @@ void NetworkBinding::Send(const Napi::CallbackInfo& info) {
             std::memcpy(&hash, start, 8);
         }
         else {
-            Napi::TypeError::New(env, "Invalid `hash` option for send(): provided Buffer length is not 8")
-                .ThrowAsJavaScriptException();
-            return;
+            return "Invalid `hash` option for " + function + ": provided Buffer length is not 8";
+        }
+    }
+    // Or a BigInt holding the hash, which needs no conversion at all
+    else if (arg_hash.IsBigInt()) {
+        bool lossless = false;
+        hash          = arg_hash.As<Napi::BigInt>().Uint64Value(&lossless);
+        if (!lossless) {
+            return "Invalid `hash` option for " + function + ": provided BigInt does not fit in 64 bits";
         }
     }
     else {
-        Napi::TypeError::New(env, "Invalid `hash` option for send(): expected a string or Buffer")
-            .ThrowAsJavaScriptException();
-        return;
+        return "Invalid `hash` option for " + function + ": expected a string, Buffer or BigInt";
     }
 
-    // Perform the send
-    try {
-        this->net.send(hash, payload, target, reliable);
-    }
-    catch (const std::exception& ex) {
-        Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
-    }
+    return "";
 }
 
 void NetworkBinding::OnPacket(const Napi::CallbackInfo& info) {
@@ -146,26 +459,426 @@ void NetworkBinding::OnPacket(const Napi::CallbackInfo& info) {
     // Function to execute on the network thread
     on_packet = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "OnPacket", 0, 1);
 
+    // Completed packets are held until the end of the process() pass that produced them, so they can all be
+    // delivered to javascript in a single call
     this->net.set_packet_callback([this](const NUClearNetwork::NetworkTarget& t,
                                          const uint64_t& hash,
                                          const bool& reliable,
                                          std::vector<uint8_t>&& payload) {
-        std::string name                       = t.name;
-        std::pair<std::string, in_port_t> addr = t.target.address();
-        on_packet.BlockingCall(
-            [name, addr, hash, reliable, p = std::move(payload)](Napi::Env env, Napi::Function js_callback) {
-                js_callback.Call({
-                    Napi::String::New(env, name),
-                    Napi::String::New(env, addr.first),
-                    Napi::Number::New(env, addr.second),
-                    Napi::Boolean::New(env, reliable),
-                    Napi::Buffer<uint8_t>::Copy(env, reinterpret_cast<const uint8_t*>(&hash), sizeof(uint64_t)),
-                    Napi::Buffer<uint8_t>::Copy(env, p.data(), p.size()),
-                });
-            });
+        // Attach the type name here so javascript doesn't need to look it up
+        std::string type;
+        /* Mutex Scope */ {
+            const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            auto it = subscriptions.find(hash);
+            if (it != subscriptions.end()) {
+                type = it->second;
+            }
+        }
+        QueuePacket(Packet{t.name, t.target.address(), std::move(type), hash, reliable, std::move(payload)});
+    });
+
+    // Pieces of streamed packets are queued the same way, marked with the packet they belong to
+    this->net.set_stream_callback([this](const NUClearNetwork::NetworkTarget& t,
+                                         const uint64_t& hash,
+                                         const uint32_t& packet_id,
+                                         std::vector<uint8_t>&& piece,
+                                         const bool& last) {
+        std::string type;
+        /* Mutex Scope */ {
+            const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            auto it = subscriptions.find(hash);
+            if (it != subscriptions.end()) {
+                type = it->second;
+            }
+        }
+        Packet packet{t.name, t.target.address(), std::move(type), hash, true, std::move(piece)};
+        packet.streamed   = true;
+        packet.stream     = packet_id;
+        packet.stream_end = last;
+        QueuePacket(std::move(packet));
+    });
+
+    // Packets nobody is listening to are dropped before they are assembled
+    this->net.set_packet_filter([this](const uint64_t& hash) { return WantPacket(hash); });
+    this->net.set_stream_filter([this](const uint64_t& hash) {
+        const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+        return streamed_types.count(hash) > 0;
+    });
+
+    // When blocking, the network only reads as many datagrams as there is room for in the queue
+    this->net.set_receive_limit([this]() -> size_t {
+        const std::lock_guard<std::mutex> lock(packets_mutex);
+        if (queue_policy != QueuePolicy::BLOCK || max_queue_size == 0) {
+            return std::numeric_limits<size_t>::max();
+        }
+        if (packets.size() >= max_queue_size) {
+            ingress_blocked = true;
+            return 0;
+        }
+        return max_queue_size - packets.size();
+    });
+
+    // Tell our peers which types we are subscribed to, so they don't send us the ones we would drop anyway
+    this->net.set_advertise_interest(true);
+}
+
+bool NetworkBinding::WantPacket(const uint64_t& hash) {
+    if (forward_all) {
+        return true;
+    }
+
+    const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+    return subscriptions.count(hash) > 0;
+}
+
+void NetworkBinding::Subscribe(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Invalid input for subscribe(): expected a string").ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::string type = info[0].As<Napi::String>().Utf8Value();
+    uint64_t hash    = 0;
+
+    // If we were given the hash already we don't need to calculate it
+    if (info.Length() > 1 && info[1].IsBigInt()) {
+        bool lossless = false;
+        hash          = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+        if (!lossless) {
+            Napi::TypeError::New(env, "Invalid hash for subscribe(): BigInt does not fit in 64 bits")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+    }
+    else {
+        hash = xxhash64(type.c_str(), type.size(), 0x4e55436c);
+    }
+
+    /* Mutex Scope */ {
+        const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+        subscriptions[hash] = std::move(type);
+    }
+
+    // Join the multicast group this type is sent to, if data is spread over them
+    net.listen(hash, true);
+}
+
+void NetworkBinding::Unsubscribe(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1) {
+        Napi::TypeError::New(env, "Invalid input for unsubscribe(): expected a string or BigInt")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    uint64_t hash           = 0;
+    const std::string error = ReadHash(info[0], "unsubscribe()", hash);
+    if (!error.empty()) {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+
+    /* Mutex Scope */ {
+        const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+        subscriptions.erase(hash);
+    }
+    hash_buffers.erase(hash);
+
+    net.listen(hash, false);
+}
+
+void NetworkBinding::StreamType(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[1].IsBoolean()) {
+        Napi::TypeError::New(env, "Invalid input for streamType(): expected a string or BigInt and a boolean")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    uint64_t hash           = 0;
+    const std::string error = ReadHash(info[0], "streamType()", hash);
+    if (!error.empty()) {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+
+    const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+    if (info[1].As<Napi::Boolean>().Value()) {
+        streamed_types.insert(hash);
+    }
+    else {
+        streamed_types.erase(hash);
+    }
+}
+
+void NetworkBinding::CompressType(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[1].IsBoolean()) {
+        Napi::TypeError::New(env, "Invalid input for compressType(): expected a string or BigInt and a boolean")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    uint64_t hash           = 0;
+    const std::string error = ReadHash(info[0], "compressType()", hash);
+    if (!error.empty()) {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+
+    const std::lock_guard<std::mutex> lock(subscriptions_mutex);
+    if (info[1].As<Napi::Boolean>().Value()) {
+        uncompressed_types.erase(hash);
+    }
+    else {
+        uncompressed_types.insert(hash);
+    }
+}
+
+void NetworkBinding::ForwardAll(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsBoolean()) {
+        Napi::TypeError::New(env, "Invalid input for forwardAll(): expected a boolean").ThrowAsJavaScriptException();
+        return;
+    }
+
+    forward_all = info[0].As<Napi::Boolean>().Value();
+    net.listen_all(forward_all);
+}
+
+void NetworkBinding::QueuePacket(Packet&& packet) {
+    std::unique_lock<std::mutex> lock(packets_mutex);
+
+    // If javascript isn't keeping up, apply the queue policy to make room
+    // Pieces of streams are never dropped, losing one would leave a hole in the middle of the stream
+    if (max_queue_size > 0 && packets.size() >= max_queue_size && !packet.streamed) {
+        switch (queue_policy) {
+            // The network doesn't read more datagrams than there is room for, so only a stream piece can get here
+            case QueuePolicy::BLOCK: break;
+
+            case QueuePolicy::DROP_NEWEST: ++packets_dropped; return;
+
+            case QueuePolicy::DROP_OLDEST: {
+                auto it = std::find_if(packets.begin(), packets.end(), [](const Packet& p) { return !p.streamed; });
+                if (it != packets.end()) {
+                    packets.erase(it);
+                    ++packets_dropped;
+                }
+            } break;
+
+            case QueuePolicy::DROP_UNRELIABLE: {
+                if (!packet.reliable) {
+                    ++packets_dropped;
+                    return;
+                }
+
+                // Reliable packets have already been acknowledged so they must not be lost, make room for them by
+                // dropping the oldest unreliable packet if there is one
+                auto it = std::find_if(packets.begin(), packets.end(), [](const Packet& p) { return !p.reliable; });
+                if (it != packets.end()) {
+                    packets.erase(it);
+                    ++packets_dropped;
+                }
+            } break;
+        }
+    }
+
+    if (packets.empty()) {
+        packets_since = std::chrono::steady_clock::now();
+    }
+    packets.push_back(std::move(packet));
+
+    // Don't let the batch grow past the maximum size
+    if (max_batch_size > 0 && packets.size() >= max_batch_size) {
+        lock.unlock();
+        DeliverPackets();
+    }
+}
+
+void NetworkBinding::WaitForIngress() {
+    std::unique_lock<std::mutex> lock(packets_mutex);
+    packets_drained.wait(lock, [this] {
+        return destroyed || queue_policy != QueuePolicy::BLOCK || max_queue_size == 0
+               || packets.size() < max_queue_size;
     });
 }
 
+void NetworkBinding::FlushPackets() {
+    std::unique_lock<std::mutex> lock(packets_mutex);
+
+    if (packets.empty()) {
+        return;
+    }
+
+    // Deliver the packets unless we have been asked to hold them for a while to build up a larger batch
+    const auto due = packets_since + batch_latency;
+    lock.unlock();
+
+    if (std::chrono::steady_clock::now() >= due) {
+        DeliverPackets();
+    }
+    else {
+        ScheduleProcess(due);
+    }
+}
+
+void NetworkBinding::DeliverPackets() {
+    /* Mutex Scope */ {
+        const std::lock_guard<std::mutex> lock(packets_mutex);
+
+        // Only have one delivery waiting on javascript at a time, it will take everything that is queued
+        if (delivery_scheduled || packets.empty()) {
+            return;
+        }
+        delivery_scheduled = true;
+    }
+
+    on_packet.BlockingCall([this](Napi::Env env, Napi::Function js_callback) { DeliverBatch(env, js_callback); });
+}
+
+void NetworkBinding::DeliverBatch(const Napi::Env& env, const Napi::Function& js_callback) {
+    std::vector<Packet> batch;
+    bool more = false;
+
+    /* Mutex Scope */ {
+        const std::lock_guard<std::mutex> lock(packets_mutex);
+
+        // Take up to a batch worth of packets off the front of the queue
+        const size_t n = max_batch_size > 0 ? std::min<size_t>(max_batch_size, packets.size()) : packets.size();
+        batch.reserve(n);
+        std::move(packets.begin(), std::next(packets.begin(), n), std::back_inserter(batch));
+        packets.erase(packets.begin(), std::next(packets.begin(), n));
+        packets_delivered += n;
+
+        // If there are packets left over we stay scheduled and come back for them after this batch
+        more               = !packets.empty();
+        delivery_scheduled = more;
+    }
+
+    // Let the listener know it can read again if it was waiting on us, and have the network read what it left behind
+    packets_drained.notify_all();
+    if (ingress_blocked.exchange(false)) {
+        ScheduleProcess(std::chrono::steady_clock::now());
+    }
+
+    if (more) {
+        on_packet.BlockingCall([this](Napi::Env env, Napi::Function js_callback) { DeliverBatch(env, js_callback); });
+    }
+
+    // Packets are flattened into a single array, with each packet taking up PACKET_FIELDS consecutive entries
+    Napi::Array out = Napi::Array::New(env, batch.size() * PACKET_FIELDS);
+
+    uint32_t i = 0;
+    for (auto& p : batch) {
+        out.Set(i++, Napi::String::New(env, p.name));
+        out.Set(i++, Napi::String::New(env, p.address.first));
+        out.Set(i++, Napi::Number::New(env, p.address.second));
+        out.Set(i++, Napi::Boolean::New(env, p.reliable));
+        out.Set(i++, HashBuffer(env, p.hash, !p.type.empty()));
+        out.Set(i++, PayloadBuffer(env, std::move(p.payload)));
+        out.Set(i++, p.type.empty() ? env.Undefined() : Napi::String::New(env, p.type));
+        out.Set(i++, p.streamed ? Napi::Number::New(env, p.stream) : env.Undefined());
+        out.Set(i++, Napi::Boolean::New(env, p.stream_end));
+    }
+
+    js_callback.Call({out});
+}
+
+Napi::Value NetworkBinding::Stats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    const std::lock_guard<std::mutex> lock(packets_mutex);
+
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("packetsQueued", Napi::Number::New(env, double(packets.size())));
+    stats.Set("packetsDropped", Napi::Number::New(env, double(packets_dropped)));
+    stats.Set("packetsDelivered", Napi::Number::New(env, double(packets_delivered)));
+
+    const auto pool = this->net.buffer_pool_stats();
+    stats.Set("bufferPoolHits", Napi::Number::New(env, double(pool.hits)));
+    stats.Set("bufferPoolMisses", Napi::Number::New(env, double(pool.misses)));
+    stats.Set("bufferPoolAvailable", Napi::Number::New(env, double(pool.available)));
+
+    const auto transmit = this->net.transmit_stats();
+    stats.Set("datagramsSent", Napi::Number::New(env, double(transmit.datagrams)));
+    stats.Set("sendCalls", Napi::Number::New(env, double(transmit.system_calls)));
+    stats.Set("acksSent", Napi::Number::New(env, double(transmit.acks)));
+    stats.Set("packetsCompressed", Napi::Number::New(env, double(transmit.compressed)));
+    stats.Set("packetsIncompressible", Napi::Number::New(env, double(transmit.incompressible)));
+    stats.Set("compressionInputBytes", Napi::Number::New(env, double(transmit.compression_input)));
+    stats.Set("compressionOutputBytes", Napi::Number::New(env, double(transmit.compression_output)));
+    stats.Set("peersSkipped", Napi::Number::New(env, double(transmit.skipped)));
+    return stats;
+}
+
+void NetworkBinding::ReleasePayload(Napi::Reference<Napi::TypedArray>* ref) {
+    // References can only be released on the main thread, so if the network thread was the last to use the payload
+    // send the reference back to be released there
+    if (std::this_thread::get_id() == main_thread) {
+        delete ref;
+    }
+    else {
+        const napi_status status =
+            on_packet.BlockingCall([ref](Napi::Env /*env*/, Napi::Function /*js_callback*/) { delete ref; });
+
+        // If the thread safe function is closing we can't get back to the main thread, so leave it to be released
+        // there by whoever is closing it
+        if (status != napi_ok) {
+            const std::lock_guard<std::mutex> lock(orphans_mutex);
+            orphaned_payloads.push_back(ref);
+        }
+    }
+}
+
+void NetworkBinding::ReleaseOrphanedPayloads() {
+    std::vector<Napi::Reference<Napi::TypedArray>*> orphans;
+    /* Mutex Scope */ {
+        const std::lock_guard<std::mutex> lock(orphans_mutex);
+        std::swap(orphans, orphaned_payloads);
+    }
+    for (auto* ref : orphans) {
+        delete ref;
+    }
+}
+
+Napi::Value NetworkBinding::HashBuffer(const Napi::Env& env, const uint64_t& hash, const bool& subscribed) {
+    // Reuse the same Buffer for each type we subscribe to, there are only a handful of those
+    auto it = hash_buffers.find(hash);
+    if (it != hash_buffers.end()) {
+        return it->second.Value();
+    }
+
+    // Anything else comes from whoever is on the network, so caching it would let them grow the cache without bound
+    auto buffer = Napi::Buffer<uint8_t>::Copy(env, reinterpret_cast<const uint8_t*>(&hash), sizeof(uint64_t));
+    if (subscribed) {
+        hash_buffers.emplace(hash, Napi::Persistent(buffer));
+    }
+    return buffer;
+}
+
+Napi::Value NetworkBinding::PayloadBuffer(const Napi::Env& env, std::vector<uint8_t>&& payload) {
+    // External buffers can't be zero length, and there is nothing to copy anyway
+    if (payload.empty()) {
+        return Napi::Buffer<uint8_t>::New(env, 0);
+    }
+
+    // Move the payload to the heap and give ownership of it to the Buffer, the finalizer frees it once the Buffer
+    // has been garbage collected (or immediately if the runtime made a copy as it doesn't allow external buffers)
+    auto* data = new std::vector<uint8_t>(std::move(payload));
+    return Napi::Buffer<uint8_t>::NewOrCopy(
+        env,
+        data->data(),
+        data->size(),
+        [](Napi::Env /*env*/, uint8_t* /*bytes*/, std::vector<uint8_t>* hint) { delete hint; },
+        data);
+}
+
 void NetworkBinding::OnJoin(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
@@ -204,19 +917,200 @@ void NetworkBinding::OnLeave(const Napi::CallbackInfo& info) {
     });
 }
 
-void NetworkBinding::OnWait(const Napi::CallbackInfo& info) {
+void NetworkBinding::ScheduleProcess(const std::chrono::steady_clock::time_point& t) {
+    using namespace std::chrono;
+
+    // The network thread keeps its own timer, bring it forward if this is sooner and wake the thread up to notice
+    if (network_thread) {
+        const steady_clock::rep ticks = t.time_since_epoch().count();
+        steady_clock::rep current     = next_process.load();
+        while (ticks < current) {
+            if (next_process.compare_exchange_weak(current, ticks)) {
+                Notify();
+                break;
+            }
+        }
+        return;
+    }
+
+    // Otherwise we are on the main thread, so bring our timer forward if this is sooner than it is set for
+    if (process_timer == nullptr || !active || (uv_is_active(reinterpret_cast<uv_handle_t*>(process_timer)) != 0
+                                                && t >= process_timer_due)) {
+        return;
+    }
+
+    // Round up so we don't wake up just before the event is due
+    const int64_t ms = duration_cast<milliseconds>(t - steady_clock::now() + microseconds(999)).count();
+    process_timer_due = t;
+    uv_timer_start(process_timer, &NetworkBinding::OnProcessTimer, uint64_t(std::max<int64_t>(ms, 0)), 0);
+}
+
+void NetworkBinding::OnProcessTimer(uv_timer_t* handle) {
+    auto* binding = static_cast<NetworkBinding*>(handle->data);
+
+    binding->ProcessNetwork();
+
+    // The network doesn't always ask to be processed again (e.g. after a retransmission between two announces)
+    // So if it didn't, make sure we check back in 100ms while we are still connected
+    if (binding->active && uv_is_active(reinterpret_cast<uv_handle_t*>(handle)) == 0) {
+        binding->process_timer_due = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        uv_timer_start(handle, &NetworkBinding::OnProcessTimer, 100, 0);
+    }
+}
+
+void NetworkBinding::CloseTimer() {
+    if (process_timer != nullptr) {
+        uv_close(reinterpret_cast<uv_handle_t*>(process_timer),
+                 [](uv_handle_t* handle) { delete reinterpret_cast<uv_timer_t*>(handle); });
+        process_timer = nullptr;
+    }
+}
+
+void NetworkBinding::Configure(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
-    // Function to execute on the network thread
-    on_wait = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "OnWait", 0, 1);
-
-    this->net.set_next_event_callback([this](const std::chrono::steady_clock::time_point& t) {
-        using namespace std::chrono;
-        // Add 1 to account for any funky rounding
-        int ms = 1 + duration_cast<duration<int, std::milli>>(t - steady_clock::now()).count();
-        on_wait.BlockingCall(
-            [ms](Napi::Env env, Napi::Function js_callback) { js_callback.Call({Napi::Number::New(env, ms)}); });
-    });
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Invalid options for configure(): expected an object").ThrowAsJavaScriptException();
+        return;
+    }
+
+    const Napi::Object options          = info[0].As<Napi::Object>();
+    const Napi::Value arg_max_batch     = options.Get("maxBatchSize");
+    const Napi::Value arg_batch_latency = options.Get("batchLatency");
+    const Napi::Value arg_max_queue     = options.Get("maxQueueSize");
+    const Napi::Value arg_queue_policy  = options.Get("queuePolicy");
+    const Napi::Value arg_thread        = options.Get("networkThread");
+    const Napi::Value arg_congestion    = options.Get("congestionControl");
+    const Napi::Value arg_compression   = options.Get("compressionThreshold");
+    const Napi::Value arg_type_groups   = options.Get("typeGroups");
+    const Napi::Value arg_max_message   = options.Get("maxMessageSize");
+
+    // Lock so the packet callback sees a consistent set of options
+    const std::lock_guard<std::mutex> lock(packets_mutex);
+
+    // Maximum number of packets to deliver to javascript in one call, 0 for no limit
+    if (arg_max_batch.IsNumber()) {
+        max_batch_size = arg_max_batch.As<Napi::Number>().Uint32Value();
+    }
+    else if (!arg_max_batch.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `maxBatchSize` option for configure(): expected a number")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // How long packets can be held in order to deliver them in a larger batch
+    if (arg_batch_latency.IsNumber()) {
+        batch_latency = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(arg_batch_latency.As<Napi::Number>().DoubleValue()));
+    }
+    else if (!arg_batch_latency.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `batchLatency` option for configure(): expected a number")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // Maximum number of packets that can be waiting for javascript, 0 for no limit
+    if (arg_max_queue.IsNumber()) {
+        max_queue_size = arg_max_queue.As<Napi::Number>().Uint32Value();
+    }
+    else if (!arg_max_queue.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `maxQueueSize` option for configure(): expected a number")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // What to do when the queue is full
+    if (arg_queue_policy.IsString()) {
+        const std::string policy = arg_queue_policy.As<Napi::String>().Utf8Value();
+        if (policy == "block") {
+            queue_policy = QueuePolicy::BLOCK;
+        }
+        else if (policy == "drop-oldest") {
+            queue_policy = QueuePolicy::DROP_OLDEST;
+        }
+        else if (policy == "drop-newest") {
+            queue_policy = QueuePolicy::DROP_NEWEST;
+        }
+        else if (policy == "drop-unreliable") {
+            queue_policy = QueuePolicy::DROP_UNRELIABLE;
+        }
+        else {
+            Napi::TypeError::New(env,
+                                 "Invalid `queuePolicy` option for configure(): expected one of 'block', "
+                                 "'drop-oldest', 'drop-newest' or 'drop-unreliable'")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+    }
+    else if (!arg_queue_policy.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `queuePolicy` option for configure(): expected a string")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // Whether the network is run on its own thread, this takes effect on the next reset()
+    if (arg_thread.IsBoolean()) {
+        configured_network_thread = arg_thread.As<Napi::Boolean>().Value();
+    }
+    else if (!arg_thread.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `networkThread` option for configure(): expected a boolean")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // How reliable packets to a target are paced, this applies to packets sent from now on
+    if (arg_congestion.IsString()) {
+        const std::string mode = arg_congestion.As<Napi::String>().Utf8Value();
+        if (mode == "aimd") {
+            net.set_congestion_control(NUClearNetwork::CongestionControl::AIMD);
+        }
+        else if (mode == "none") {
+            net.set_congestion_control(NUClearNetwork::CongestionControl::NONE);
+        }
+        else {
+            Napi::TypeError::New(env, "Invalid `congestionControl` option for configure(): expected 'aimd' or 'none'")
+                .ThrowAsJavaScriptException();
+            return;
+        }
+    }
+    else if (!arg_congestion.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `congestionControl` option for configure(): expected a string")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // How large packets have to be before they are compressed, 0 to never compress them
+    if (arg_compression.IsNumber()) {
+        net.set_compression_threshold(arg_compression.As<Napi::Number>().Uint32Value());
+    }
+    else if (!arg_compression.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `compressionThreshold` option for configure(): expected a number")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // How many multicast groups untargeted data is spread over by type, this takes effect on the next reset()
+    if (arg_type_groups.IsNumber() && arg_type_groups.As<Napi::Number>().Uint32Value() <= 255) {
+        net.set_type_groups(uint8_t(arg_type_groups.As<Napi::Number>().Uint32Value()));
+    }
+    else if (!arg_type_groups.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `typeGroups` option for configure(): expected a number from 0 to 255")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // The largest packet we accept from the network, 0 to accept any size
+    if (arg_max_message.IsNumber() && arg_max_message.As<Napi::Number>().DoubleValue() >= 0) {
+        net.set_max_message_size(size_t(arg_max_message.As<Napi::Number>().DoubleValue()));
+    }
+    else if (!arg_max_message.IsUndefined()) {
+        Napi::TypeError::New(env, "Invalid `maxMessageSize` option for configure(): expected a positive number")
+            .ThrowAsJavaScriptException();
+        return;
+    }
+
+    // The new options might have made room
+    packets_drained.notify_all();
 }
 
 void NetworkBinding::Reset(const Napi::CallbackInfo& info) {
@@ -253,17 +1147,25 @@ void NetworkBinding::Reset(const Napi::CallbackInfo& info) {
 
     // Perform the reset
     try {
+        const std::lock_guard<std::mutex> lock(this->net_mutex);
+
+        // Let any existing network listener know it has been replaced
+        ++this->listener_generation;
+        Notify();
+
+        // The new listener and any processing we schedule from here on agree on where the network is run
+        this->network_thread = this->configured_network_thread;
+
         this->net.reset(name, group, port, network_mtu);
+        this->active = true;
 
         // NetworkListener extends AsyncProgressWorker, which will automatically
         // destruct itself when done (i.e. when Execute() returns and OnOK() or
         // OnError() are called and return)
         auto asyncWorker = new NetworkListener(env, this);
 
-#ifdef _WIN32
-        // Keep track of the NetworkListener notifier, so we can signal it to exit WSAWaitForMultipleEvents()
+        // Keep track of the NetworkListener notifier, so we can wake it from its wait on the sockets
         this->listenerNotifier = asyncWorker->notifier;
-#endif
 
         // Queue the worker
         asyncWorker->Queue();
@@ -278,19 +1180,73 @@ void NetworkBinding::Process(const Napi::CallbackInfo& info) {
 
     // Perform the process function
     try {
+        const std::lock_guard<std::mutex> lock(this->net_mutex);
         this->net.process();
+        FlushPackets();
     }
     catch (const std::exception& ex) {
         Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
     }
 }
 
+void NetworkBinding::ProcessNetwork() {
+    const std::lock_guard<std::mutex> lock(this->net_mutex);
+
+    // Don't touch the network once we have been destroyed
+    if (this->destroyed) {
+        return;
+    }
+
+    // Clear the time we were asked to process at, process() will ask again if it needs to
+    next_process = std::chrono::steady_clock::duration::max().count();
+
+    try {
+        this->net.process();
+        FlushPackets();
+    }
+    catch (const std::exception&) {
+        // We can't throw to javascript as we are in another thread
+        // Still we don't want to crash the process so swallow the exception
+    }
+}
+
+int NetworkBinding::ProcessTimeout() {
+    using namespace std::chrono;
+
+    // Wait until the network next asked to be processed, but wake up at least every 100ms in case it didn't ask
+    const steady_clock::time_point next{steady_clock::duration(next_process.load())};
+    const auto ms = next == steady_clock::time_point::max()
+                        ? 100
+                        : 1 + duration_cast<milliseconds>(next - steady_clock::now()).count();
+    return int(std::max<decltype(ms)>(0, std::min<decltype(ms)>(ms, 100)));
+}
+
+void NetworkBinding::Notify() {
+#ifdef _WIN32
+    WSASetEvent(this->listenerNotifier);
+#else
+    if (this->listenerNotifier >= 0) {
+        const char c = 0;
+        if (::write(this->listenerNotifier, &c, 1) < 0) {
+            // If the pipe is full the listener already has a wakeup waiting so there is nothing to do
+        }
+    }
+#endif
+}
+
 void NetworkBinding::Shutdown(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     // Perform the shutdown function
     try {
+        const std::lock_guard<std::mutex> lock(this->net_mutex);
         this->net.shutdown();
+
+        // Stop processing the network now it's gone
+        this->active = false;
+        if (process_timer != nullptr) {
+            uv_timer_stop(process_timer);
+        }
     }
     catch (const std::exception& ex) {
         Napi::Error::New(env, ex.what()).ThrowAsJavaScriptException();
@@ -298,28 +1254,54 @@ void NetworkBinding::Shutdown(const Napi::CallbackInfo& info) {
 }
 
 void NetworkBinding::Destroy(const Napi::CallbackInfo& info) {
-    // Set destroyed, to exit the read loop in the network listener
-    this->destroyed = true;
+    /* Mutex Scope */ {
+        // Lock the network so the network thread (if we have one) is not using it while we pull it apart
+        const std::lock_guard<std::mutex> lock(this->net_mutex);
 
-#ifdef _WIN32
-    // Signal the network listener notifier, to exit WSAWaitForMultipleEvents()
-    WSASetEvent(this->listenerNotifier);
-#endif
+        // Set destroyed, to exit the read loop in the network listener
+        this->destroyed = true;
+
+        // Signal the network listener notifier, to exit its wait on the sockets
+        Notify();
+
+        // Create empty lambdas for the callbacks, to prevent them from being called
+        this->net.set_packet_callback([](const NUClearNetwork::NetworkTarget& t,
+                                         const uint64_t& hash,
+                                         const bool& reliable,
+                                         std::vector<uint8_t>&& payload) {});
+        this->net.set_stream_callback([](const NUClearNetwork::NetworkTarget& t,
+                                         const uint64_t& hash,
+                                         const uint32_t& packet_id,
+                                         std::vector<uint8_t>&& piece,
+                                         const bool& last) {});
+        this->net.set_join_callback([](const NUClearNetwork::NetworkTarget& t) {});
+        this->net.set_leave_callback([](const NUClearNetwork::NetworkTarget& t) {});
+        this->net.set_next_event_callback([](std::chrono::steady_clock::time_point t) {});
+
+        // Give up on anything still waiting to be acknowledged while we are on the main thread, so the payloads it
+        // holds are released here rather than by the network thread once it can no longer send them back to us
+        this->net.shutdown();
+    }
 
-    // Create empty lambdas for the callbacks, to prevent them from being called
-    this->net.set_packet_callback([](const NUClearNetwork::NetworkTarget& t,
-                                     const uint64_t& hash,
-                                     const bool& reliable,
-                                     std::vector<uint8_t>&& payload) {});
-    this->net.set_join_callback([](const NUClearNetwork::NetworkTarget& t) {});
-    this->net.set_leave_callback([](const NUClearNetwork::NetworkTarget& t) {});
-    this->net.set_next_event_callback([](std::chrono::steady_clock::time_point t) {});
+    // Stop and close our timer
+    this->active = false;
+    CloseTimer();
 
-    // Release the thread safe functions
+    // Drop any packets that were waiting to be delivered, and wake the listener if it was waiting for room
+    /* Mutex Scope */ {
+        const std::lock_guard<std::mutex> lock(packets_mutex);
+        packets.clear();
+    }
+    packets_drained.notify_all();
+
+    // Release the thread safe functions, once nothing is left that needs them to get back to the main thread
+    ReleaseOrphanedPayloads();
     on_packet.Release();
     on_join.Release();
     on_leave.Release();
-    on_wait.Release();
+
+    // Drop our cached hash buffers so they can be garbage collected
+    hash_buffers.clear();
 }
 
 void NetworkBinding::Init(Napi::Env env, Napi::Object exports) {
@@ -328,6 +1310,18 @@ void NetworkBinding::Init(Napi::Env env, Napi::Object exports) {
                                       {InstanceMethod<&NetworkBinding::Send>(
                                            "send",
                                            static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::SendBatch>(
+                                           "sendBatch",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::OpenStream>(
+                                           "openStream",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::WriteStream>(
+                                           "writeStream",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::AbortStream>(
+                                           "abortStream",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                        InstanceMethod<&NetworkBinding::OnPacket>(
                                            "onPacket",
                                            static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
@@ -337,8 +1331,26 @@ void NetworkBinding::Init(Napi::Env env, Napi::Object exports) {
                                        InstanceMethod<&NetworkBinding::OnLeave>(
                                            "onLeave",
                                            static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
-                                       InstanceMethod<&NetworkBinding::OnWait>(
-                                           "onWait",
+                                       InstanceMethod<&NetworkBinding::Configure>(
+                                           "configure",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::Stats>(
+                                           "stats",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::Subscribe>(
+                                           "subscribe",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::Unsubscribe>(
+                                           "unsubscribe",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::StreamType>(
+                                           "streamType",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::CompressType>(
+                                           "compressType",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::ForwardAll>(
+                                           "forwardAll",
                                            static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                        InstanceMethod<&NetworkBinding::Reset>(
                                            "reset",
@@ -352,6 +1364,9 @@ void NetworkBinding::Init(Napi::Env env, Napi::Object exports) {
                                        InstanceMethod<&NetworkBinding::Hash>(
                                            "hash",
                                            static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
+                                       InstanceMethod<&NetworkBinding::TypeHash>(
+                                           "typeHash",
+                                           static_cast<napi_property_attributes>(napi_writable | napi_configurable)),
                                        InstanceMethod<&NetworkBinding::Destroy>(
                                            "destroy",
                                            static_cast<napi_property_attributes>(napi_writable | napi_configurable))});
@@ -19,6 +19,19 @@
 #define NETWORKBINDING_H
 
 #include <napi.h>
+#include <uv.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "nuclear/src/extension/network/NUClearNetwork.hpp"
 
@@ -27,27 +40,126 @@ namespace NUClear {
 class NetworkBinding : public Napi::ObjectWrap<NetworkBinding> {
 public:
     NetworkBinding(const Napi::CallbackInfo& info);
+    ~NetworkBinding();
 
     Napi::Value Hash(const Napi::CallbackInfo& info);
-    void Send(const Napi::CallbackInfo& info);
+    Napi::Value TypeHash(const Napi::CallbackInfo& info);
+    Napi::Value Send(const Napi::CallbackInfo& info);
+    Napi::Value SendBatch(const Napi::CallbackInfo& info);
+    Napi::Value OpenStream(const Napi::CallbackInfo& info);
+    Napi::Value WriteStream(const Napi::CallbackInfo& info);
+    void AbortStream(const Napi::CallbackInfo& info);
     void OnPacket(const Napi::CallbackInfo& info);
     void OnJoin(const Napi::CallbackInfo& info);
     void OnLeave(const Napi::CallbackInfo& info);
-    void OnWait(const Napi::CallbackInfo& info);
+    void Configure(const Napi::CallbackInfo& info);
+    Napi::Value Stats(const Napi::CallbackInfo& info);
+    void Subscribe(const Napi::CallbackInfo& info);
+    void Unsubscribe(const Napi::CallbackInfo& info);
+    void StreamType(const Napi::CallbackInfo& info);
+    void CompressType(const Napi::CallbackInfo& info);
+    void ForwardAll(const Napi::CallbackInfo& info);
     void Reset(const Napi::CallbackInfo& info);
     void Process(const Napi::CallbackInfo& info);
     void Shutdown(const Napi::CallbackInfo& info);
     void Destroy(const Napi::CallbackInfo& info);
 
+    /// A completed packet, or the next piece of a streamed one, waiting to be delivered to javascript
+    struct Packet {
+        std::string name;
+        std::pair<std::string, in_port_t> address;
+        std::string type;
+        uint64_t hash;
+        bool reliable;
+        std::vector<uint8_t> payload;
+        /// If this is a piece of a streamed packet, which packet id it belongs to and if it is the last piece
+        bool streamed{false};
+        uint32_t stream{0};
+        bool stream_end{false};
+    };
+
+    /// What to do with received packets when the queue to javascript is full
+    enum class QueuePolicy { BLOCK, DROP_OLDEST, DROP_NEWEST, DROP_UNRELIABLE };
+
+    std::string ReadMessage(const Napi::Value& arg_hash,
+                            const Napi::Value& arg_payload,
+                            const Napi::Value& arg_target,
+                            const Napi::Value& arg_reliable,
+                            extension::network::NUClearNetwork::BatchMessage& message);
+    static std::string ReadHash(const Napi::Value& arg_hash, const std::string& function, uint64_t& hash);
+    static void SettleSend(const Napi::Env& env,
+                           const Napi::Promise::Deferred& deferred,
+                           const extension::network::NUClearNetwork::SendResult& result);
+    void QueuePacket(Packet&& packet);
+    void WaitForIngress();
+    void ProcessNetwork();
+    int ProcessTimeout();
+    void Notify();
+    void ReleasePayload(Napi::Reference<Napi::TypedArray>* ref);
+    void ReleaseOrphanedPayloads();
+    void FlushPackets();
+    void DeliverPackets();
+    void DeliverBatch(const Napi::Env& env, const Napi::Function& js_callback);
+    void ScheduleProcess(const std::chrono::steady_clock::time_point& t);
+    bool WantPacket(const uint64_t& hash);
+    static void OnProcessTimer(uv_timer_t* handle);
+    void CloseTimer();
+    Napi::Value HashBuffer(const Napi::Env& env, const uint64_t& hash, const bool& subscribed);
+    Napi::Value PayloadBuffer(const Napi::Env& env, std::vector<uint8_t>&& payload);
+
+    /// The number of array entries each packet takes up when delivered to javascript
+    static constexpr uint32_t PACKET_FIELDS = 9;
+    /// The number of array entries each message takes up when sent as a batch from javascript
+    static constexpr uint32_t SEND_FIELDS = 4;
+
+    std::thread::id main_thread;
     extension::network::NUClearNetwork net;
-    bool destroyed = false;
+    std::mutex net_mutex;
+    std::atomic<bool> destroyed{false};
+    /// If the network should run on its own thread, as configured by javascript and used from the next reset()
+    bool configured_network_thread = false;
+    /// If the network is running on its own thread, latched when the network is reset
+    std::atomic<bool> network_thread{false};
+    std::atomic<uint32_t> listener_generation{0};
+    std::atomic<std::chrono::steady_clock::rep> next_process{std::chrono::steady_clock::duration::max().count()};
+    /// Timer on the javascript event loop used to process the network when it next needs attention
+    uv_timer_t* process_timer = nullptr;
+    std::chrono::steady_clock::time_point process_timer_due;
+    bool active = false;
     Napi::ThreadSafeFunction on_packet;
     Napi::ThreadSafeFunction on_join;
     Napi::ThreadSafeFunction on_leave;
-    Napi::ThreadSafeFunction on_wait;
+    /// Payload references the network thread couldn't send back to be released, released on the main thread instead
+    std::mutex orphans_mutex;
+    std::vector<Napi::Reference<Napi::TypedArray>*> orphaned_payloads;
+    /// The Buffers holding the hashes of the types we subscribe to, reused for every packet of those types
+    std::map<uint64_t, Napi::Reference<Napi::Buffer<uint8_t>>> hash_buffers;
+    /// The types javascript is listening to, and whether it wants every packet regardless of type
+    std::mutex subscriptions_mutex;
+    std::map<uint64_t, std::string> subscriptions;
+    /// The types javascript wants delivered a piece at a time, guarded by the subscriptions mutex
+    std::set<uint64_t> streamed_types;
+    /// The types javascript doesn't want compressed when they are sent, guarded by the subscriptions mutex
+    std::set<uint64_t> uncompressed_types;
+    std::atomic<bool> forward_all{false};
+    std::mutex packets_mutex;
+    std::condition_variable packets_drained;
+    std::deque<Packet> packets;
+    std::chrono::steady_clock::time_point packets_since;
+    bool delivery_scheduled    = false;
+    uint64_t packets_dropped   = 0;
+    uint64_t packets_delivered = 0;
+    uint32_t max_batch_size    = 0;
+    std::chrono::steady_clock::duration batch_latency{0};
+    uint32_t max_queue_size  = 0;
+    QueuePolicy queue_policy = QueuePolicy::BLOCK;
+    /// If the network stopped reading as the queue was full, so it needs processing again once there is room
+    std::atomic<bool> ingress_blocked{false};
 
 #ifdef _WIN32
     WSAEVENT listenerNotifier;
+#else
+    fd_t listenerNotifier = -1;
 #endif
 
     static void Init(Napi::Env env, Napi::Object exports);
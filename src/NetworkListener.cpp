@@ -17,11 +17,16 @@
 
 #include "NetworkListener.hpp"
 
+#include <array>
 #include <iostream>
+#include <system_error>
 
 namespace NUClear {
 NetworkListener::NetworkListener(Napi::Env& env, NetworkBinding* binding)
-    : Napi::AsyncProgressWorker<char>(env), binding(binding) {
+    : Napi::AsyncProgressWorker<char>(env)
+    , binding(binding)
+    , threaded(binding->network_thread)
+    , generation(binding->listener_generation) {
     std::vector<NUClear::fd_t> notifyfds = this->binding->net.listen_fds();
 
 #ifdef _WIN32
@@ -52,7 +57,22 @@ NetworkListener::NetworkListener(Napi::Env& env, NetworkBinding* binding)
     for (auto& fd : notifyfds) {
         this->fds.push_back(pollfd{fd, POLLIN, 0});
     }
+
+    // Create a pipe to use for the notifier (used for getting out of poll())
+    std::array<int, 2> pipe_fds{};
+    if (::pipe(pipe_fds.data()) != 0) {
+        throw std::system_error(errno, std::system_category(), "pipe() for notifier failed");
+    }
+    this->notifier_read = pipe_fds[0];
+    this->notifier      = pipe_fds[1];
+    ::fcntl(this->notifier_read, F_SETFL, ::fcntl(this->notifier_read, F_GETFL) | O_NONBLOCK);
+    ::fcntl(this->notifier, F_SETFL, ::fcntl(this->notifier, F_GETFL) | O_NONBLOCK);
+
+    this->fds.push_back(pollfd{this->notifier_read, POLLIN, 0});
 #endif  // _WIN32
+
+    // Keep the binding alive while we are using it
+    this->binding->Ref();
 }
 
 NetworkListener::~NetworkListener() {
@@ -63,20 +83,37 @@ NetworkListener::~NetworkListener() {
                       << std::endl;
         }
     }
+#else
+    // Stop the binding from writing to our notifier once it's closed
+    if (this->binding->listenerNotifier == this->notifier) {
+        this->binding->listenerNotifier = -1;
+    }
+    ::close(this->notifier_read);
+    ::close(this->notifier);
 #endif
+
+    this->binding->Unref();
 }
 
 void NetworkListener::Execute(const Napi::AsyncProgressWorker<char>::ExecutionProgress& p) {
     bool run = true;
 
-    // The run loop: runs until we get an FD close (setting run to false) or the network binding is destroyed
-    while (run && !this->binding->destroyed) {
+    // The run loop: runs until we get an FD close (setting run to false), the network binding is destroyed, or the
+    // binding is reset and replaces us with a new listener
+    while (run && !this->binding->destroyed && this->generation == this->binding->listener_generation) {
         bool data = false;
 
+        // If javascript has fallen behind and asked us to block, stop reading until it has caught up
+        this->binding->WaitForIngress();
+
 #ifdef _WIN32
         // Wait for events and check for shutdown
-        auto event_index =
-            WSAWaitForMultipleEvents(this->events.size(), this->events.data(), false, WSA_INFINITE, false);
+        // When we run the network ourselves we also need to wake up when it next needs processing
+        auto event_index = WSAWaitForMultipleEvents(this->events.size(),
+                                                    this->events.data(),
+                                                    false,
+                                                    this->threaded ? this->binding->ProcessTimeout() : WSA_INFINITE,
+                                                    false);
 
         // Check if the return value is an event in our list
         if (event_index >= WSA_WAIT_EVENT_0 && event_index < WSA_WAIT_EVENT_0 + this->events.size()) {
@@ -113,7 +150,10 @@ void NetworkListener::Execute(const Napi::AsyncProgressWorker<char>::ExecutionPr
         }
 #else
         // Wait for events and check for shutdown
-        poll(this->fds.data(), static_cast<nfds_t>(this->fds.size()), 500);
+        // When we run the network ourselves we also need to wake up when it next needs processing
+        poll(this->fds.data(),
+             static_cast<nfds_t>(this->fds.size()),
+             this->threaded ? this->binding->ProcessTimeout() : 500);
 
         // Check if the connections closed
         for (const auto& fd : this->fds) {
@@ -121,14 +161,26 @@ void NetworkListener::Execute(const Napi::AsyncProgressWorker<char>::ExecutionPr
                 run = false;
             }
             else if ((fd.revents & POLLIN) != 0) {
-                data = true;
+                // Empty the notifier pipe, it has done its job of waking us up
+                if (fd.fd == this->notifier_read) {
+                    std::array<char, 64> buffer{};
+                    while (::read(this->notifier_read, buffer.data(), buffer.size()) > 0) {
+                    }
+                }
+                else {
+                    data = true;
+                }
             }
         }
 #endif  // _WIN32
 
-        // Notify the system something happened if we're running and have data to read.
+        // In threaded mode we own the network, so process it here whether we were woken by data or a timeout
+        if (run && this->threaded) {
+            this->binding->ProcessNetwork();
+        }
+        // Otherwise notify the system something happened if we're running and have data to read.
         // Will trigger OnProgress() below to read the data.
-        if (run && data) {
+        else if (run && data) {
             p.Signal();
         }
     }
@@ -136,13 +188,7 @@ void NetworkListener::Execute(const Napi::AsyncProgressWorker<char>::ExecutionPr
 
 void NetworkListener::OnProgress(const char*, size_t) {
     // If we're here in OnProgress(), then there's data to process
-    try {
-        this->binding->net.process();
-    }
-    catch (const std::exception&) {
-        // We can't throw to javascript as we are in another thread
-        // Still we don't want to crash the process so swallow the exception
-    }
+    this->binding->ProcessNetwork();
 }
 
 void NetworkListener::OnOK() {}
@@ -35,12 +35,19 @@ public:
 
     NetworkBinding* binding;
 
+    /// If this listener runs the network itself rather than signalling the main thread to
+    bool threaded;
+    /// The listener generation of the binding when we were created, if it changes we have been replaced
+    uint32_t generation;
+
 #ifdef _WIN32
     std::vector<WSAEVENT> events;
     std::vector<SOCKET> fds;
     WSAEVENT notifier;
 #else
     std::vector<pollfd> fds;
+    fd_t notifier;
+    fd_t notifier_read;
 #endif  // _WIN32
 };
 
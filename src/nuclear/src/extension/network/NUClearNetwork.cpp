@@ -23,16 +23,36 @@
 #include "NUClearNetwork.hpp"
 
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <iterator>
+#include <limits>
+#include <random>
 #include <ratio>
 #include <stdexcept>
 #include <system_error>
 #include <utility>
 
+#include "../../util/network/chunk_stride.hpp"
 #include "../../util/network/if_number_from_address.hpp"
 #include "../../util/network/resolve.hpp"
 #include "../../util/platform.hpp"
+#include "../../util/serialise/lz4.hpp"
+
+#ifdef __linux__
+    #include <netinet/udp.h>
+
+    // Older headers don't know about UDP generic segmentation offload
+    #ifndef UDP_SEGMENT
+        #define UDP_SEGMENT 103
+    #endif
+    #ifndef UDP_GRO
+        #define UDP_GRO 104
+    #endif
+    #ifndef SOL_UDP
+        #define SOL_UDP 17
+    #endif
+#endif  // __linux__
 
 namespace NUClear {
 namespace extension {
@@ -41,14 +61,12 @@ namespace extension {
         /**
          * Read a single packet from the given udp file descriptor.
          *
-         * @param fd The file descriptor to read from
+         * @param fd      The file descriptor to read from
+         * @param payload A buffer large enough to hold the datagram, it is resized to the datagram that was read
          *
          * @return The data and who it was sent from
          */
-        std::pair<util::network::sock_t, std::vector<uint8_t>> read_socket(fd_t fd) {
-
-            // Allocate a vector that can hold a datagram
-            std::vector<uint8_t> payload(1500);
+        std::pair<util::network::sock_t, std::vector<uint8_t>> read_socket(fd_t fd, std::vector<uint8_t>&& payload) {
             iovec iov{};
             iov.iov_base = reinterpret_cast<char*>(payload.data());
             iov.iov_len  = static_cast<decltype(iov.iov_len)>(payload.size());
@@ -65,17 +83,236 @@ namespace extension {
 
             // Now read the data for real
             const ssize_t received = recvmsg(fd, &mh, 0);
-            payload.resize(received);
+            payload.resize(std::max<ssize_t>(received, 0));
 
             return {from, std::move(payload)};
         }
 
+        /**
+         * Check if an address is a multicast group.
+         *
+         * @param address The address to check
+         *
+         * @return true if the address is an ipv4 or ipv6 multicast address
+         */
+        bool is_multicast(const util::network::sock_t& address) {
+            return (address.sock.sa_family == AF_INET
+                    && (ntohl(address.ipv4.sin_addr.s_addr) & 0xF0000000) == 0xE0000000)
+                   || (address.sock.sa_family == AF_INET6 && address.ipv6.sin6_addr.s6_addr[0] == 0xFF);
+        }
+
+        /**
+         * Count how many bits are set in a byte.
+         *
+         * @param bits The byte to count
+         *
+         * @return the number of bits that are set
+         */
+        size_t count_bits(uint8_t bits) {
+            size_t count = 0;
+            for (; bits != 0; bits &= uint8_t(bits - 1)) {
+                ++count;
+            }
+            return count;
+        }
+
+        /**
+         * Count how many bits are set in a bitset.
+         *
+         * @param bits The bytes of the bitset
+         *
+         * @return the number of bits that are set
+         */
+        size_t count_bits(const std::vector<uint8_t>& bits) {
+            size_t count = 0;
+            for (const auto& b : bits) {
+                count += count_bits(b);
+            }
+            return count;
+        }
+
+        /**
+         * Work out the address of one of the multicast groups untargeted data is spread over by type.
+         * They count up from the announce group, so they are in the same scope.
+         *
+         * @param announce The multicast group we announce on
+         * @param index    Which of the type groups it is
+         *
+         * @return the address of the type group
+         */
+        util::network::sock_t type_group_address(const util::network::sock_t& announce, const uint32_t& index) {
+            util::network::sock_t group = announce;
+            if (announce.sock.sa_family == AF_INET) {
+                // Only the low 23 bits of an ipv4 group make it into its ethernet address, so we count up within them
+                // for network cards to be able to tell the groups apart
+                const uint32_t address     = ntohl(announce.ipv4.sin_addr.s_addr);
+                const uint32_t low         = (address + 1 + index) & 0x007FFFFF;
+                group.ipv4.sin_addr.s_addr = htonl((address & 0xFF800000) | low);
+            }
+            else if (announce.sock.sa_family == AF_INET6) {
+                // Ipv6 groups use their low 32 bits for their ethernet address
+                uint32_t low = 0;
+                std::memcpy(&low, &announce.ipv6.sin6_addr.s6_addr[12], sizeof(low));
+                low = htonl(ntohl(low) + 1 + index);
+                std::memcpy(&group.ipv6.sin6_addr.s6_addr[12], &low, sizeof(low));
+            }
+            return group;
+        }
+
         NUClearNetwork::PacketQueue::PacketTarget::PacketTarget(std::weak_ptr<NetworkTarget> target,
+                                                                std::string name,
                                                                 std::vector<uint8_t> acked)
-            : target(std::move(target)), acked(std::move(acked)), last_send(std::chrono::steady_clock::now()) {}
+            : target(std::move(target))
+            , name(std::move(name))
+            , acked(std::move(acked))
+            , last_send(std::chrono::steady_clock::now()) {}
 
         NUClearNetwork::PacketQueue::PacketQueue() = default;
 
+        void NUClearNetwork::BufferPool::resize(size_t size) {
+            const std::lock_guard<std::mutex> lock(mutex);
+            buffer_size = size;
+            buffers.erase(std::remove_if(buffers.begin(),
+                                         buffers.end(),
+                                         [size](const std::vector<uint8_t>& b) { return b.capacity() < size; }),
+                          buffers.end());
+        }
+
+        size_t NUClearNetwork::BufferPool::size() const {
+            return buffer_size;
+        }
+
+        std::vector<uint8_t> NUClearNetwork::BufferPool::acquire() {
+            std::vector<uint8_t> buffer;
+
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(mutex);
+                if (!buffers.empty()) {
+                    ++hits;
+                    buffer = std::move(buffers.back());
+                    buffers.pop_back();
+                }
+                else {
+                    ++misses;
+                }
+            }
+
+            buffer.resize(buffer_size);
+            return buffer;
+        }
+
+        void NUClearNetwork::BufferPool::release(std::vector<uint8_t>&& buffer) {
+            if (buffer.capacity() < buffer_size) {
+                return;
+            }
+
+            const std::lock_guard<std::mutex> lock(mutex);
+            if (buffers.size() < MAX_POOLED) {
+                buffers.push_back(std::move(buffer));
+            }
+        }
+
+        NUClearNetwork::BufferPoolStats NUClearNetwork::BufferPool::stats() {
+            const std::lock_guard<std::mutex> lock(mutex);
+            BufferPoolStats stats;
+            stats.hits      = hits;
+            stats.misses    = misses;
+            stats.available = buffers.size();
+            return stats;
+        }
+
+        NUClearNetwork::BufferPoolStats NUClearNetwork::buffer_pool_stats() {
+            return receive_pool.stats();
+        }
+
+        NUClearNetwork::PacketQueue* NUClearNetwork::SendQueue::find(uint32_t packet_id) {
+            const uint16_t slot = uint16_t(packet_id);
+            if (index.empty() || index[slot] == EMPTY || packets[index[slot]].header.packet_id != packet_id) {
+                return nullptr;
+            }
+            return &packets[index[slot]];
+        }
+
+        bool NUClearNetwork::SendQueue::available(uint32_t packet_id) const {
+            return index.empty() || index[uint16_t(packet_id)] == EMPTY;
+        }
+
+        NUClearNetwork::PacketQueue& NUClearNetwork::SendQueue::insert(uint32_t packet_id) {
+            if (index.empty()) {
+                index.resize(size_t(std::numeric_limits<uint16_t>::max()) + 1, uint16_t(EMPTY));
+            }
+
+            index[uint16_t(packet_id)] = uint16_t(packets.size());
+            packets.emplace_back();
+            packets.back().header.packet_id = packet_id;
+            packets.back().sequence         = ++sequence;
+            return packets.back();
+        }
+
+        void NUClearNetwork::SendQueue::erase(uint32_t packet_id) {
+            if (find(packet_id) != nullptr) {
+                erase(packets.begin() + index[uint16_t(packet_id)]);
+            }
+        }
+
+        NUClearNetwork::SendQueue::iterator NUClearNetwork::SendQueue::erase(iterator it) {
+            const auto position                   = std::distance(packets.begin(), it);
+            index[uint16_t(it->header.packet_id)] = EMPTY;
+
+            // Fill the hole with the last packet so the array stays dense
+            if (std::next(it) != packets.end()) {
+                *it                                   = std::move(packets.back());
+                index[uint16_t(it->header.packet_id)] = uint16_t(position);
+            }
+            packets.pop_back();
+
+            return packets.begin() + position;
+        }
+
+        void NUClearNetwork::SendQueue::clear() {
+            packets.clear();
+            if (!index.empty()) {
+                std::fill(index.begin(), index.end(), uint16_t(EMPTY));
+            }
+        }
+
+        size_t NUClearNetwork::SendQueue::size() const {
+            return packets.size();
+        }
+
+        bool NUClearNetwork::SendQueue::empty() const {
+            return packets.empty();
+        }
+
+        NUClearNetwork::SendQueue::iterator NUClearNetwork::SendQueue::begin() {
+            return packets.begin();
+        }
+
+        NUClearNetwork::SendQueue::iterator NUClearNetwork::SendQueue::end() {
+            return packets.end();
+        }
+
+        void NUClearNetwork::complete(PacketQueue& queue, const std::string& error) {
+            // A writer waiting for room in a stream has nothing left to wait for
+            if (queue.on_ready) {
+                auto ready     = std::move(queue.on_ready);
+                queue.on_ready = nullptr;
+                ready();
+            }
+
+            if (queue.on_complete) {
+                SendResult result;
+                result.delivered = error.empty();
+                result.error     = error;
+                result.latency   = std::move(queue.latency);
+
+                // Take the callback out first so we can only ever report once
+                auto callback     = std::move(queue.on_complete);
+                queue.on_complete = nullptr;
+                callback(result);
+            }
+        }
+
         NUClearNetwork::~NUClearNetwork() {
             shutdown();
         }
@@ -85,59 +322,101 @@ namespace extension {
             packet_callback = std::move(f);
         }
 
+        void NUClearNetwork::set_packet_filter(std::function<bool(const uint64_t&)> f) {
+            packet_filter = std::move(f);
+        }
 
-        void NUClearNetwork::set_join_callback(std::function<void(const NetworkTarget&)> f) {
-            join_callback = std::move(f);
+        void NUClearNetwork::set_stream_filter(std::function<bool(const uint64_t&)> f) {
+            stream_filter = std::move(f);
         }
 
+        void NUClearNetwork::set_receive_limit(std::function<size_t()> f) {
+            receive_limit = std::move(f);
+        }
 
-        void NUClearNetwork::set_leave_callback(std::function<void(const NetworkTarget&)> f) {
-            leave_callback = std::move(f);
+        void NUClearNetwork::set_stream_callback(StreamCallback f) {
+            stream_callback = std::move(f);
         }
 
-        void NUClearNetwork::set_next_event_callback(std::function<void(std::chrono::steady_clock::time_point)> f) {
-            next_event_callback = std::move(f);
+        void NUClearNetwork::set_compression_threshold(size_t threshold) {
+            compression_threshold = threshold;
         }
 
-        std::array<uint16_t, 9> NUClearNetwork::udp_key(const sock_t& address) {
+        void NUClearNetwork::set_max_message_size(size_t size) {
+            max_message_size = size;
+        }
 
-            // Get our keys for our maps, it will be the ip and then port
-            std::array<uint16_t, 9> key = {0};
+        void NUClearNetwork::set_compression_filter(std::function<bool(const uint64_t&)> f) {
+            compression_filter = std::move(f);
+        }
 
-            switch (address.sock.sa_family) {
-                case AF_INET:
-                    // The first chars are 0 (ipv6) and after that is our address and then port
-                    std::memcpy(&key[6], &address.ipv4.sin_addr, sizeof(address.ipv4.sin_addr));
-                    key[8] = address.ipv4.sin_port;
-                    break;
+        void NUClearNetwork::set_type_groups(uint8_t count) {
+            type_group_count = count;
+        }
 
-                case AF_INET6:
-                    // IPv6 address then port
-                    std::memcpy(key.data(), &address.ipv6.sin6_addr, sizeof(address.ipv6.sin6_addr));
-                    key[8] = address.ipv6.sin6_port;
-                    break;
+        void NUClearNetwork::listen(const uint64_t& hash, bool listening) {
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(groups_mutex);
+                if (listening) {
+                    listened_types.insert(hash);
+                }
+                else {
+                    listened_types.erase(hash);
+                }
+                update_memberships();
+                update_interest();
+            }
+            announce_soon();
+        }
 
-                default: throw std::invalid_argument("Unknown address family");
+        void NUClearNetwork::listen_all(bool listening) {
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(groups_mutex);
+                listening_all = listening;
+                update_memberships();
+                update_interest();
+            }
+            announce_soon();
+        }
+
+        void NUClearNetwork::set_advertise_interest(bool advertise) {
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(groups_mutex);
+                advertise_interest = advertise;
+                update_interest();
             }
+            announce_soon();
+        }
+
+        void NUClearNetwork::set_congestion_control(CongestionControl mode) {
+            congestion_control = mode;
+        }
 
-            return key;
+
+        void NUClearNetwork::set_join_callback(std::function<void(const NetworkTarget&)> f) {
+            join_callback = std::move(f);
+        }
+
+
+        void NUClearNetwork::set_leave_callback(std::function<void(const NetworkTarget&)> f) {
+            leave_callback = std::move(f);
         }
 
+        void NUClearNetwork::set_next_event_callback(std::function<void(std::chrono::steady_clock::time_point)> f) {
+            next_event_callback = std::move(f);
+        }
 
         void NUClearNetwork::remove_target(const std::shared_ptr<NetworkTarget>& target) {
 
             // Erase udp
-            auto key = udp_key(target->target);
-            if (udp_target.find(key) != udp_target.end()) {
-                udp_target.erase(udp_target.find(key));
-            }
+            udp_target.erase(target->target.key());
 
             // Erase name
-            auto range = name_target.equal_range(target->name);
-            for (auto it = range.first; it != range.second; ++it) {
-                if (it->second == target) {
-                    name_target.erase(it);
-                    break;
+            auto* named = name_target.find(target->name);
+            if (named != nullptr) {
+                named->erase(std::remove(named->begin(), named->end(), target), named->end());
+                if (named->empty()) {
+                    name_target.erase(target->name);
                 }
             }
 
@@ -181,16 +460,18 @@ namespace extension {
                                         std::system_category(),
                                         "Unable to bind the UDP socket to the port");
             }
+
+#ifdef __linux__
+            // Ask the kernel to hand us runs of datagrams from the same sender as one buffer, fine if it can't
+            gro_enabled = ::setsockopt(data_fd, SOL_UDP, UDP_GRO, &yes, sizeof(yes)) == 0;
+#endif  // __linux__
         }
 
 
         void NUClearNetwork::open_announce(const sock_t& announce_target, const sock_t& bind_address) {
 
             // Work out what type of announce we are doing as it will influence how we make the socket
-            const bool multicast =
-                (announce_target.sock.sa_family == AF_INET
-                 && (ntohl(announce_target.ipv4.sin_addr.s_addr) & 0xF0000000) == 0xE0000000)
-                || (announce_target.sock.sa_family == AF_INET6 && announce_target.ipv6.sin6_addr.s6_addr[0] == 0xFF);
+            const bool multicast = is_multicast(announce_target);
 
             // Make our socket
             announce_fd = ::socket(bind_address.sock.sa_family, SOCK_DGRAM, IPPROTO_UDP);
@@ -290,24 +571,154 @@ namespace extension {
             }
         }
 
+        bool NUClearNetwork::set_membership(const sock_t& group, bool join) {
+            if (group.sock.sa_family == AF_INET) {
+                ip_mreq mreq{};
+                mreq.imr_multiaddr = group.ipv4.sin_addr;
+                mreq.imr_interface = membership_interface.ipv4.sin_addr;
+                return ::setsockopt(announce_fd,
+                                    IPPROTO_IP,
+                                    join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+                                    reinterpret_cast<char*>(&mreq),
+                                    sizeof(ip_mreq))
+                       == 0;
+            }
+            if (group.sock.sa_family == AF_INET6) {
+                ipv6_mreq mreq{};
+                mreq.ipv6mr_multiaddr = group.ipv6.sin6_addr;
+                mreq.ipv6mr_interface = util::network::if_number_from_address(membership_interface.ipv6);
+                return ::setsockopt(announce_fd,
+                                    IPPROTO_IPV6,
+                                    join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP,
+                                    reinterpret_cast<char*>(&mreq),
+                                    sizeof(ipv6_mreq))
+                       == 0;
+            }
+            return false;
+        }
+
+        void NUClearNetwork::update_memberships() {
+
+            // Nothing to do if we aren't using type groups, or can't
+            if (type_groups.empty() || type_groups_failed || announce_fd == INVALID_SOCKET) {
+                return;
+            }
+
+            // The groups that have a type we listen to sent to them
+            std::vector<bool> wanted(type_groups.size(), listening_all);
+            for (const auto& hash : listened_types) {
+                wanted[hash % type_groups.size()] = true;
+            }
+
+            for (size_t i = 0; i < type_groups.size(); ++i) {
+                if (wanted[i] != joined_groups[i]) {
+                    if (set_membership(type_groups[i], wanted[i])) {
+                        joined_groups[i] = wanted[i];
+                    }
+                    // If we can't join a group (there is a limit to how many a socket can join) we would miss the
+                    // data sent to it, so we give up on them and have everything sent to the announce group instead
+                    else if (wanted[i]) {
+                        for (size_t j = 0; j < type_groups.size(); ++j) {
+                            if (joined_groups[j]) {
+                                set_membership(type_groups[j], false);
+                                joined_groups[j] = false;
+                            }
+                        }
+                        type_groups_failed = true;
+
+                        // Tell everyone to send us everything on the announce group
+                        if (announce_packet_v3.size() >= sizeof(AnnouncePacketV3)) {
+                            reinterpret_cast<AnnouncePacketV3*>(announce_packet_v3.data())->type_groups = 0;
+                        }
+                        return;
+                    }
+                }
+            }
+        }
+
+        void NUClearNetwork::update_interest() {
+
+            interest.clear();
+            if (listening_all) {
+                interest.fill();
+            }
+            else {
+                for (const auto& hash : listened_types) {
+                    interest.insert(hash);
+                }
+            }
+            ++interest_version;
+
+            // Our announce packet isn't built until we reset
+            if (announce_packet_v3.size() >= sizeof(AnnouncePacketV3)) {
+                AnnouncePacketV3& pkt = *reinterpret_cast<AnnouncePacketV3*>(announce_packet_v3.data());
+                pkt.features          = uint8_t(advertise_interest ? FEATURE_LZ4 | FEATURE_INTEREST : FEATURE_LZ4);
+                pkt.interest_version  = interest_version;
+                std::memcpy(pkt.interest, interest.data(), interest.size());
+            }
+        }
+
+        void NUClearNetwork::announce_soon() {
+            if (advertise_interest) {
+                announce_due = true;
+                if (next_event_callback) {
+                    next_event_callback(std::chrono::steady_clock::now());
+                }
+            }
+        }
+
+        const util::network::sock_t* NUClearNetwork::type_group(const uint64_t& hash, bool reliable) const {
+
+            // Everyone has to agree on the groups, or someone listening would miss the data
+            // Reliable data is only acknowledged by those who listen to it, so they have to tell us who they are
+            if (type_groups.empty() || type_groups_failed) {
+                return nullptr;
+            }
+            for (const auto& t : targets) {
+                if (!t->name.empty()
+                    && (t->type_groups != type_groups.size() || (reliable && (t->features & FEATURE_INTEREST) == 0))) {
+                    return nullptr;
+                }
+            }
+            return &type_groups[hash % type_groups.size()];
+        }
+
         void NUClearNetwork::shutdown() {
 
             // If we have an fd, send a shutdown message
-            if (data_fd > 0) {
+            if (data_fd > 0 && name_target.find("") != nullptr) {
                 // Make a leave packet from our announce packet
                 LeavePacket packet;
 
-                auto announce_targets = name_target.equal_range("");
-                for (auto it = announce_targets.first; it != announce_targets.second; ++it) {
+                for (const auto& t : *name_target.find("")) {
 
                     // Send the packet
                     ::sendto(data_fd,
                              reinterpret_cast<const char*>(&packet),
                              sizeof(packet),
                              0,
-                             &it->second->target.sock,
-                             it->second->target.size());
+                             &t->target.sock,
+                             t->target.size());
+                }
+            }
+
+            // Anything still waiting to be acknowledged never will be now
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(send_queue_mutex);
+                for (auto& queue : send_queue) {
+                    complete(queue, "The network was shut down before every target acknowledged the packet");
                 }
+                send_queue.clear();
+                retransmit_events = decltype(retransmit_events)();
+                next_retransmit   = std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+                next_pump         = std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+            }
+            next_ack = std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+
+            // Datagrams we hadn't got to yet were for the old sockets
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(coalesced_mutex);
+                receive_backlog.clear();
             }
 
             // Close our existing FDs if they exist
@@ -337,10 +748,15 @@ namespace extension {
 
             // Clear all our data structures
             send_queue.clear();
+            retransmit_events = decltype(retransmit_events)();
             name_target.clear();
             targets.clear();
             udp_target.clear();
 
+            // Start our packet ids somewhere random, so if we restart before our peers notice we left they are
+            // unlikely to mistake our new packets for ones they have already seen
+            packet_id_source = uint32_t(std::random_device()());
+
             // Resolve the announce address and port into a sockaddr
             const util::network::sock_t announce_target = util::network::resolve(address, port);
 
@@ -369,18 +785,23 @@ namespace extension {
             // Add the target for our multicast packets
             auto all_target = std::make_shared<NetworkTarget>("", announce_target);
             targets.push_front(all_target);
-            name_target.insert(std::make_pair("", all_target));
-            udp_target.insert(std::make_pair(udp_key(announce_target), all_target));
+            name_target[""].push_back(all_target);
+            udp_target[announce_target.key()] = all_target;
 
             // Work out our MTU for udp packets
-            packet_data_mtu = network_mtu;              // Start with the total mtu
-            packet_data_mtu -= sizeof(DataPacket) - 1;  // Now remove data packet header size
+            // Chunks are the same size whichever version they are sent as, so leave room for the larger header
+            packet_data_mtu = network_mtu;                // Start with the total mtu
+            packet_data_mtu -= sizeof(DataPacketV3) - 1;  // Now remove data packet header size
             // IPv6 headers are always 40 bytes, and IPv4 can be 20-60 but if we assume 40 for all cases it should
             // be safe enough
             packet_data_mtu -= 40;  // Remove size of an IPv4 header or IPv6 header
             packet_data_mtu -= 8;   // Size of a UDP packet header
 
-            // Build our announce packet
+            // Our receive buffers need to hold a whole datagram, but never go below the default so we can still hear
+            // peers that are using it
+            receive_pool.resize(std::max<size_t>(network_mtu, 1500));
+
+            // Build our announce packets
             announce_packet.resize(sizeof(AnnouncePacket) + name.size(), 0);
             AnnouncePacket& pkt = *reinterpret_cast<AnnouncePacket*>(announce_packet.data());
             pkt                 = AnnouncePacket();
@@ -389,6 +810,54 @@ namespace extension {
             // Open the data and announce sockets
             open_data(bind_target);
             open_announce(announce_target, bind_target);
+
+            // Spread untargeted data over multicast groups by type if we have been asked to and can
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(groups_mutex);
+                type_groups.clear();
+                if (is_multicast(announce_target)) {
+                    for (uint32_t i = 0; i < type_group_count; ++i) {
+                        type_groups.push_back(type_group_address(announce_target, i));
+                    }
+                }
+                joined_groups.assign(type_groups.size(), false);
+                membership_interface = bind_target;
+                type_groups_failed   = false;
+
+                if (!type_groups.empty()) {
+#ifdef IP_MULTICAST_ALL
+                    // Only receive the groups we have joined, not every group something else on this host has joined
+                    int no = 0;
+                    if (announce_target.sock.sa_family == AF_INET) {
+                        ::setsockopt(announce_fd,
+                                     IPPROTO_IP,
+                                     IP_MULTICAST_ALL,
+                                     reinterpret_cast<char*>(&no),
+                                     sizeof(no));
+                    }
+    #ifdef IPV6_MULTICAST_ALL
+                    else if (announce_target.sock.sa_family == AF_INET6) {
+                        ::setsockopt(announce_fd,
+                                     IPPROTO_IPV6,
+                                     IPV6_MULTICAST_ALL,
+                                     reinterpret_cast<char*>(&no),
+                                     sizeof(no));
+                    }
+    #endif  // IPV6_MULTICAST_ALL
+#endif  // IP_MULTICAST_ALL
+                    update_memberships();
+                }
+
+                // Peers that only understand version 2 ignore the version 3 announce, so we send both
+                // The version 3 announce also tells peers which optional features we support, the type groups we use
+                // and which types we listen to
+                announce_packet_v3.assign(sizeof(AnnouncePacketV3) + name.size(), 0);
+                AnnouncePacketV3& pkt_v3 = *reinterpret_cast<AnnouncePacketV3*>(announce_packet_v3.data());
+                pkt_v3                   = AnnouncePacketV3();
+                pkt_v3.type_groups       = type_groups_failed ? 0 : uint8_t(type_groups.size());
+                std::memcpy(&pkt_v3.name, name.c_str(), name.size());
+                update_interest();
+            }
         }
 
         void NUClearNetwork::reset(const std::string& name,
@@ -403,12 +872,13 @@ namespace extension {
             // Record the time
             auto now = std::chrono::steady_clock::now();
 
-            // Check if we should announce now
-            if (now - last_announce > std::chrono::milliseconds(500)) {
+            // Check if we should announce now, or straight away if our announce has changed
+            if (announce_due.exchange(false) || now - last_announce > std::chrono::milliseconds(500)) {
                 last_announce = now;
                 announce();
 
                 // Update our event timer
+                const std::lock_guard<std::mutex> lock(send_queue_mutex);
                 auto next_announce = now + std::chrono::milliseconds(500);
                 if (next_announce > next_event) {
                     next_event = next_announce;
@@ -445,162 +915,676 @@ namespace extension {
                 leave_callback(*l);
             }
 
-            // Check if we have packets to resend and if so resend
-            if (!send_queue.empty()) {
-                retransmit();
-            }
+            // Read packets from the multicast socket while there is data available
+            receive(announce_fd);
 
-            // Used for storing how many bytes are available on a socket
-            unsigned long count = 0;  // NOLINT(google-runtime-int) MSVC wants an unsigned long
+            // Then everything waiting on the data socket, acks that have arrived mean those chunks aren't lost
+            receive(data_fd);
 
-            // Read packets from the multicast socket while there is data available
-            ioctl(announce_fd, FIONREAD, &(count = 0));
-            while (count > 0) {
-                auto packet = read_socket(announce_fd);
-                process_packet(packet.first, std::move(packet.second));
-                ioctl(announce_fd, FIONREAD, &(count = 0));
+            // Send the acks we held back waiting for more chunks
+            now = std::chrono::steady_clock::now();
+            if (now.time_since_epoch().count() >= next_ack) {
+                flush_acks();
             }
 
-            // Check if we have a packet available on the data socket
-            ioctl(data_fd, FIONREAD, &(count = 0));
-            while (count > 0) {
-                auto packet = read_socket(data_fd);
-                process_packet(packet.first, std::move(packet.second));
-                ioctl(data_fd, FIONREAD, &(count = 0));
+            // Check if we have packets that are due to be resent and if so resend
+            if (now.time_since_epoch().count() >= next_retransmit) {
+                retransmit();
             }
-        }
-
-        void NUClearNetwork::retransmit() {
-
-            // Locking send_queue_mutex second after target_mutex
-            std::lock(target_mutex, send_queue_mutex);
-            const std::lock_guard<std::mutex> target_lock(target_mutex, std::adopt_lock);
-            const std::lock_guard<std::mutex> send_lock(send_queue_mutex, std::adopt_lock);
-
-            for (auto qit = send_queue.begin(); qit != send_queue.end();) {
-                for (auto it = qit->second.targets.begin(); it != qit->second.targets.end();) {
 
-                    // Get the pointer to our target
-                    auto ptr = it->target.lock();
+            // Send any chunks that were waiting for their pacing rate to allow them
+            if (now.time_since_epoch().count() >= next_pump) {
+                pump_all();
+            }
+        }
 
-                    // If our pointer is valid (they haven't disconnected)
-                    if (ptr) {
+#ifdef __linux__
+        bool NUClearNetwork::receive_coalesced(fd_t fd) {
+
+            // Each buffer the kernel gives us can hold many datagrams, along with the size they were all cut to
+            struct Control {
+                alignas(cmsghdr) char buffer[CMSG_SPACE(sizeof(int))];
+            };
+            std::array<mmsghdr, COALESCED_BATCH_SIZE> messages{};
+            std::array<iovec, COALESCED_BATCH_SIZE> iov{};
+            std::array<sock_t, COALESCED_BATCH_SIZE> from{};
+            std::array<Control, COALESCED_BATCH_SIZE> control{};
+
+            // Only one thread at a time can use the coalesced buffers, the others wait for it to empty the socket
+            const std::lock_guard<std::mutex> lock(coalesced_mutex);
+
+            // Whatever was left over from last time comes first
+            size_t room = receive_limit ? receive_limit() : std::numeric_limits<size_t>::max();
+            while (room > 0 && !receive_backlog.empty()) {
+                auto& datagram = receive_backlog.front();
+                process_packet(datagram.first, datagram.second.data(), datagram.second.size());
+                receive_pool.release(std::move(datagram.second));
+                receive_backlog.pop_front();
+                --room;
+            }
 
-                        auto now     = std::chrono::steady_clock::now();
-                        auto timeout = it->last_send + ptr->round_trip_time;
+            while (true) {
+                // Each buffer holds at least one datagram, so don't read more buffers than we have room for
+                room = receive_limit ? receive_limit() : std::numeric_limits<size_t>::max();
+                const size_t batch = std::min(size_t(COALESCED_BATCH_SIZE), room);
+                if (batch == 0 || !receive_backlog.empty()) {
+                    return true;
+                }
 
-                        // Check if we should have expected an ack by now for some packets
-                        if (timeout < now) {
+                for (size_t i = 0; i < batch; ++i) {
+                    coalesced_buffers[i].resize(MAX_COALESCED_SIZE);
+                    iov[i].iov_base = coalesced_buffers[i].data();
+                    iov[i].iov_len  = coalesced_buffers[i].size();
+
+                    messages[i].msg_hdr                = msghdr{};
+                    messages[i].msg_hdr.msg_name       = &from[i].sock;
+                    messages[i].msg_hdr.msg_namelen    = sizeof(from[i]);
+                    messages[i].msg_hdr.msg_iov        = &iov[i];
+                    messages[i].msg_hdr.msg_iovlen     = 1;
+                    messages[i].msg_hdr.msg_control    = control[i].buffer;
+                    messages[i].msg_hdr.msg_controllen = sizeof(control[i].buffer);
+                }
 
-                            // We last sent now
-                            it->last_send = now;
+                const int received = ::recvmmsg(fd, messages.data(), batch, MSG_DONTWAIT, nullptr);
 
-                            // The next time we should check for a timeout
-                            auto next_timeout = now + ptr->round_trip_time;
-                            if (next_timeout < next_event) {
-                                next_event = next_timeout;
-                                next_event_callback(next_event);
-                            }
+                // Try again if we were interrupted
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                }
+                // Without recvmmsg turn coalescing back off so a plain read gets one datagram at a time
+                if (received < 0 && errno == ENOSYS) {
+                    int no = 0;
+                    ::setsockopt(fd, SOL_UDP, UDP_GRO, &no, sizeof(no));
+                    gro_enabled = false;
+                    return false;
+                }
+                // Otherwise there is nothing left to read
+                if (received <= 0) {
+                    return true;
+                }
 
-                            // Work out which packets to resend and resend them
-                            for (uint16_t i = 0; i < qit->second.header.packet_count; ++i) {
-                                if ((it->acked[i / 8] & uint8_t(1 << (i % 8))) == 0) {
-                                    send_packet(ptr->target, qit->second.header, i, qit->second.payload, true);
-                                }
-                            }
+                for (int i = 0; i < received; ++i) {
+                    const size_t length = messages[i].msg_len;
+
+                    // If the kernel joined datagrams together it tells us the size it cut them to
+                    size_t segment = length;
+                    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); cmsg != nullptr;
+                         cmsg          = CMSG_NXTHDR(&messages[i].msg_hdr, cmsg)) {
+                        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                            int size = 0;
+                            std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+                            segment = size > 0 ? size_t(size) : length;
                         }
-
-                        ++it;
                     }
-                    // Remove them from the list
-                    else {
-                        it = qit->second.targets.erase(it);
+
+                    // Split the buffer back into its datagrams and process each one where it is
+                    // Any past the receive limit are copied out and kept until there is room for them
+                    const uint8_t* data = coalesced_buffers[i].data();
+                    for (size_t offset = 0; offset < length; offset += segment) {
+                        const size_t size = std::min(segment, length - offset);
+                        if (room == 0) {
+                            auto datagram = receive_pool.acquire();
+                            datagram.assign(data + offset, data + offset + size);
+                            receive_backlog.emplace_back(from[i], std::move(datagram));
+                            continue;
+                        }
+                        --room;
+                        process_packet(from[i], data + offset, size);
                     }
                 }
 
-                if (qit->second.targets.empty()) {
-                    qit = send_queue.erase(qit);
-                }
-                else {
-                    ++qit;
+                // If we didn't fill the batch the socket is empty
+                if (received < int(batch)) {
+                    return true;
                 }
             }
         }
+#endif  // __linux__
 
-        void NUClearNetwork::announce() {
+        void NUClearNetwork::receive(fd_t fd) {
 
-            // Get all our targets that are global targets
-            auto announce_targets = name_target.equal_range("");
-            for (auto it = announce_targets.first; it != announce_targets.second; ++it) {
+#ifdef __linux__
+            // Coalesced datagrams on the data socket need large buffers and splitting up again
+            if (fd == data_fd && gro_enabled && receive_coalesced(fd)) {
+                return;
+            }
 
-                // Send the packet
-                if (::sendto(data_fd,
-                             reinterpret_cast<const char*>(announce_packet.data()),
-                             static_cast<socklen_t>(announce_packet.size()),
-                             0,
-                             &it->second->target.sock,
-                             it->second->target.size())
-                    < 0) {
-                    throw std::system_error(network_errno,
-                                            std::system_category(),
-                                            "Network error when sending the announce packet");
+            // Read as many datagrams as we can with each system call, straight into buffers from the pool
+            // process_packet copies what it needs out of the buffer, so datagrams don't need an allocation at all
+            // Each call has its own buffers, as process can be called from more than one thread at once
+            std::array<std::vector<uint8_t>, RECEIVE_BATCH_SIZE> buffers;
+            std::array<mmsghdr, RECEIVE_BATCH_SIZE> messages{};
+            std::array<iovec, RECEIVE_BATCH_SIZE> iov{};
+            std::array<sock_t, RECEIVE_BATCH_SIZE> from{};
+
+            bool supported = true;
+            while (true) {
+                // Don't read more datagrams than we have room for
+                const size_t room  = receive_limit ? receive_limit() : std::numeric_limits<size_t>::max();
+                const size_t batch = std::min(size_t(RECEIVE_BATCH_SIZE), room);
+                if (batch == 0) {
+                    break;
                 }
-            }
-        }
 
-        void NUClearNetwork::process_packet(const sock_t& address, std::vector<uint8_t>&& payload) {
+                for (size_t i = 0; i < batch; ++i) {
+                    // Make sure every buffer can hold a whole datagram, they need to grow when the mtu does
+                    auto& buffer = buffers[i];
+                    if (buffer.capacity() < receive_pool.size()) {
+                        buffer = receive_pool.acquire();
+                    }
+                    buffer.resize(receive_pool.size());
+                    iov[i].iov_base = reinterpret_cast<char*>(buffer.data());
+                    iov[i].iov_len  = buffer.size();
+
+                    messages[i].msg_hdr             = msghdr{};
+                    messages[i].msg_hdr.msg_name    = &from[i].sock;
+                    messages[i].msg_hdr.msg_namelen = sizeof(from[i]);
+                    messages[i].msg_hdr.msg_iov     = &iov[i];
+                    messages[i].msg_hdr.msg_iovlen  = 1;
+                }
 
-            // First validate this is a NUClear network packet we can read (a version 2 NUClear packet)
-            if (payload.size() >= sizeof(PacketHeader) && payload[0] == 0xE2 && payload[1] == 0x98 && payload[2] == 0xA2
-                && payload[3] == 0x02) {
+                const int received = ::recvmmsg(fd, messages.data(), batch, MSG_DONTWAIT, nullptr);
 
-                // This is a real packet! get our header information
-                const PacketHeader& header = *reinterpret_cast<const PacketHeader*>(payload.data());
+                // Try again if we were interrupted
+                if (received < 0 && errno == EINTR) {
+                    continue;
+                }
+                // Old kernels don't have recvmmsg, read the slow way instead
+                if (received < 0 && errno == ENOSYS) {
+                    supported = false;
+                    break;
+                }
+                // Otherwise there is nothing left to read
+                if (received <= 0) {
+                    break;
+                }
 
-                // Get the map key for this device
-                auto key = udp_key(address);
+                for (int i = 0; i < received; ++i) {
+                    process_packet(from[i], buffers[i].data(), messages[i].msg_len);
+                }
 
-                // From here on, we are doing things with our target lists that if changed would make us sad
-                std::shared_ptr<NetworkTarget> remote;
-                /* Mutex scope */ {
+                // If we didn't fill the batch the socket is empty
+                if (received < int(batch)) {
+                    break;
+                }
+            }
+
+            // Give the buffers back so the next call can use them
+            for (auto& buffer : buffers) {
+                receive_pool.release(std::move(buffer));
+            }
+            if (supported) {
+                return;
+            }
+#endif  // __linux__
+
+            // Used for storing how many bytes are available on a socket
+            unsigned long count = 0;  // NOLINT(google-runtime-int) MSVC wants an unsigned long
+
+            // Read packets from the socket while there is data available
+            ioctl(fd, FIONREAD, &(count = 0));
+            while (count > 0 && (!receive_limit || receive_limit() > 0)) {
+                auto packet = read_socket(fd, receive_pool.acquire());
+                process_packet(packet.first, packet.second.data(), packet.second.size());
+
+                // Now process_packet is done with the buffer it can be used again
+                receive_pool.release(std::move(packet.second));
+                ioctl(fd, FIONREAD, &(count = 0));
+            }
+        }
+
+        void NUClearNetwork::schedule_retransmit(PacketQueue& queue, std::chrono::steady_clock::time_point when) {
+            queue.next_check = when;
+            retransmit_events.push(RetransmitEvent{when, queue.header.packet_id, queue.sequence});
+
+            // Let process know it doesn't need to look at the queue until then
+            const auto& next = retransmit_events.top().due;
+            next_retransmit  = next.time_since_epoch().count();
+
+            // Make sure we are woken up in time
+            if (next < next_event) {
+                next_event = next;
+                next_event_callback(next_event);
+            }
+        }
+
+        void NUClearNetwork::retransmit() {
+
+            // Locking send_queue_mutex second after target_mutex
+            std::lock(target_mutex, send_queue_mutex);
+            const std::lock_guard<std::mutex> target_lock(target_mutex, std::adopt_lock);
+            const std::lock_guard<std::mutex> send_lock(send_queue_mutex, std::adopt_lock);
+
+            // Everything that needs resending, so it can all be sent together at the end
+            std::vector<Datagram> datagrams;
+
+            // Targets that lost paced chunks, their window decides when those are sent again
+            std::vector<std::shared_ptr<NetworkTarget>> lost;
+
+            // Only look at the packets that are due, the rest stay in the heap until it's their turn
+            const auto now = std::chrono::steady_clock::now();
+            while (!retransmit_events.empty() && retransmit_events.top().due <= now) {
+                const RetransmitEvent event = retransmit_events.top();
+                retransmit_events.pop();
+
+                // Skip events for packets that have finished, or that have been rescheduled since
+                PacketQueue* queue = send_queue.find(event.packet_id);
+                if (queue == nullptr || queue->sequence != event.sequence || queue->next_check != event.due) {
+                    continue;
+                }
+
+                // Give up on packets that have not been acknowledged in time
+                if (now > queue->deadline) {
+                    // Whatever was still in flight no longer counts against the window
+                    for (const auto& t : queue->targets) {
+                        auto ptr = t.target.lock();
+                        if (ptr) {
+                            ptr->congestion.in_flight -= std::min(ptr->congestion.in_flight, count_bits(t.sent));
+                        }
+                    }
+                    complete(*queue, "Timed out waiting for every target to acknowledge the packet");
+                    send_queue.erase(event.packet_id);
+                    continue;
+                }
+
+                // The next time this packet needs looking at
+                auto check = queue->deadline;
+
+                for (auto it = queue->targets.begin(); it != queue->targets.end();) {
+
+                    // Get the pointer to our target
+                    auto ptr = it->target.lock();
+
+                    // If our pointer is valid (they haven't disconnected)
+                    if (ptr) {
+
+                        auto timeout = it->last_send + ptr->round_trip_time;
+
+                        // Paced chunks we should have had an ack for by now are lost and go back in the window
+                        // While acks are still arriving the rest of the window is probably on its way too
+                        if (queue->paced) {
+                            timeout = std::max(it->last_send, it->last_ack) + ptr->ack_timeout();
+                            if (timeout < now) {
+                                if (lose_chunks(*ptr, *queue, *it, nullptr) > 0) {
+                                    it->last_send = now;
+                                    lost.push_back(ptr);
+                                }
+                                timeout = now + ptr->ack_timeout();
+                            }
+                        }
+                        // Check if we should have expected an ack by now for some packets
+                        else if (timeout < now) {
+
+                            // We last sent now
+                            it->last_send = now;
+                            timeout       = now + ptr->round_trip_time;
+
+                            // Work out which packets to resend and queue them up to resend
+                            add_datagrams(datagrams,
+                                          ptr->target,
+                                          queue->header,
+                                          queue->payload.get(),
+                                          queue->length,
+                                          &it->acked);
+                        }
+
+                        check = std::min(check, timeout);
+                        ++it;
+                    }
+                    // Remove them from the list
+                    else {
+                        complete(*queue, "Target " + it->name + " left before acknowledging the packet");
+                        it = queue->targets.erase(it);
+                    }
+                }
+
+                if (queue->targets.empty()) {
+                    send_queue.erase(event.packet_id);
+                }
+                else {
+                    schedule_retransmit(*queue, check);
+                }
+            }
+
+            // If nothing is waiting we don't need to come back
+            if (retransmit_events.empty()) {
+                next_retransmit = std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+            }
+            else {
+                next_retransmit = retransmit_events.top().due.time_since_epoch().count();
+            }
+
+            for (const auto& t : lost) {
+                pump(t, datagrams, now);
+            }
+
+            transmit(datagrams);
+        }
+
+        void NUClearNetwork::schedule_pump(std::chrono::steady_clock::time_point when) {
+            if (when.time_since_epoch().count() < next_pump) {
+                next_pump = when.time_since_epoch().count();
+            }
+
+            // Make sure we are woken up in time
+            if (when < next_event) {
+                next_event = when;
+                next_event_callback(next_event);
+            }
+        }
+
+        void NUClearNetwork::pump_all() {
+
+            // Locking send_queue_mutex second after target_mutex
+            std::lock(target_mutex, send_queue_mutex);
+            const std::lock_guard<std::mutex> target_lock(target_mutex, std::adopt_lock);
+            const std::lock_guard<std::mutex> send_lock(send_queue_mutex, std::adopt_lock);
+
+            // Anyone still limited by their pacing rate will schedule themselves again
+            next_pump = std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+
+            const auto now = std::chrono::steady_clock::now();
+            std::vector<Datagram> datagrams;
+            for (const auto& t : targets) {
+                if (!t->congestion.pending.empty()) {
+                    pump(t, datagrams, now);
+                }
+            }
+            transmit(datagrams);
+        }
+
+        void NUClearNetwork::pump(const std::shared_ptr<NetworkTarget>& target,
+                                  std::vector<Datagram>& datagrams,
+                                  std::chrono::steady_clock::time_point now) {
+
+            auto& cc = target->congestion;
+
+            // We pace a little faster than one window per round trip so acks can grow the window as we go
+            // The filtered round trip starts out at a second and takes a while to settle, so if the latest ack says
+            // the round trip is shorter we believe it rather than sending a handful of datagrams a second
+            const auto round_trip = std::min(target->round_trip_time, cc.latest_round_trip);
+            const double rtt      = std::max(std::chrono::duration<double>(round_trip).count(), 1e-4);
+            const double rate = cc.window * PACING_GAIN / rtt;
+
+            // Top up our tokens for the time that has passed, but never allow more than a small burst
+            if (cc.last_refill != std::chrono::steady_clock::time_point()) {
+                cc.tokens += std::chrono::duration<double>(now - cc.last_refill).count() * rate;
+                cc.tokens = std::min(cc.tokens, double(PACING_BURST));
+            }
+            cc.last_refill = now;
+
+            while (!cc.pending.empty() && double(cc.in_flight) < cc.window && cc.tokens >= 1) {
+                const auto& next = cc.pending.front();
+
+                // Find the packet and our progress sending it to this target, it may have finished since
+                PacketQueue* queue = send_queue.find(next.first);
+                PacketQueue::PacketTarget* state = nullptr;
+                if (queue != nullptr && queue->sequence == next.second) {
+                    for (auto& t : queue->targets) {
+                        if (t.target.lock() == target) {
+                            state = &t;
+                            break;
+                        }
+                    }
+                }
+                if (state == nullptr) {
+                    cc.pending.pop_front();
+                    continue;
+                }
+
+                // Skip over the chunks that have arrived or are on their way
+                // Streams can only go as far as has been written, writing more puts them back in pending
+                const uint32_t count = ready_chunks(*queue);
+                while (state->next_chunk < count
+                       && ((state->acked[state->next_chunk / 8] | state->sent[state->next_chunk / 8])
+                           & uint8_t(1 << (state->next_chunk % 8)))
+                              != 0) {
+                    ++state->next_chunk;
+                }
+                if (state->next_chunk >= count) {
+                    state->resending = false;
+                    cc.pending.pop_front();
+                    continue;
+                }
+
+                // Send this chunk, the first time it goes out as plain data so it isn't treated as a duplicate
+                const uint32_t chunk = state->next_chunk++;
+                DataPacketV3 header  = queue->header;
+                header.type          = state->resending ? DATA_RETRANSMISSION : DATA;
+                add_datagram(datagrams, target->target, *queue, header, chunk);
+
+                state->sent[chunk / 8] |= uint8_t(1 << (chunk % 8));
+                state->last_send = now;
+                ++cc.in_flight;
+                cc.tokens -= 1;
+            }
+
+            // If only our pacing rate is holding us back, come back when we have another token
+            if (!cc.pending.empty() && double(cc.in_flight) < cc.window && cc.tokens < 1) {
+                schedule_pump(now
+                              + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                  std::chrono::duration<double>((1 - cc.tokens) / rate)));
+            }
+        }
+
+        size_t NUClearNetwork::lose_chunks(NetworkTarget& target,
+                                           PacketQueue& queue,
+                                           PacketQueue::PacketTarget& it,
+                                           const uint8_t* lost,
+                                           size_t offset,
+                                           size_t size) {
+
+            auto& cc = target.congestion;
+
+            // Anything sent that hasn't been acknowledged is no longer in flight
+            size_t count = 0;
+            const size_t begin = lost == nullptr ? 0 : std::min(offset, it.sent.size());
+            const size_t end   = lost == nullptr ? it.sent.size() : std::min(offset + size, it.sent.size());
+            for (size_t i = begin; i < end; ++i) {
+                const uint8_t gone = lost == nullptr ? it.sent[i] : uint8_t(it.sent[i] & lost[i - offset]);
+                count += count_bits(gone);
+                it.sent[i] &= uint8_t(~gone);
+            }
+            // A nack can ask for chunks that had already been acknowledged, so those are always sent again
+            if (count == 0 && lost == nullptr) {
+                return 0;
+            }
+            cc.in_flight -= std::min(cc.in_flight, count);
+
+            // Send the packet again from the start, skipping what has arrived
+            it.resending  = true;
+            it.next_chunk = 0;
+            cc.pending.emplace_front(uint32_t(queue.header.packet_id), queue.sequence);
+
+            // Losing data means we are sending too fast, but only back off once for each round trip
+            const auto now = std::chrono::steady_clock::now();
+            if (count > 0 && now - cc.last_decrease > target.round_trip_time) {
+                cc.threshold     = std::max(cc.window / 2, double(MIN_WINDOW));
+                cc.window        = cc.threshold;
+                cc.last_decrease = now;
+            }
+
+            return count;
+        }
+
+        size_t NUClearNetwork::ack_chunks(PacketQueue::PacketTarget& it,
+                                          bool paced,
+                                          uint32_t count,
+                                          size_t offset,
+                                          const uint8_t* bits,
+                                          size_t size) {
+
+            size_t arrived = 0;
+            for (size_t i = offset; i < std::min(offset + size, it.acked.size()); ++i) {
+
+                // Only the chunks that are in the packet count, the rest of the last byte is padding
+                const uint8_t valid = (i + 1) * 8 <= count ? 0xFF : uint8_t(0xFF >> (8 - (count % 8)));
+                const uint8_t got   = bits == nullptr ? valid : uint8_t(bits[i - offset] & valid);
+
+                // Chunks that were in flight and have now arrived make room in the window
+                if (paced) {
+                    const uint8_t landed = it.sent[i] & got;
+                    arrived += count_bits(landed);
+                    it.sent[i] &= uint8_t(~landed);
+                }
+
+                // Update our bitset
+                it.acked_count += uint32_t(count_bits(uint8_t(got & ~it.acked[i])));
+                it.acked[i] |= got;
+            }
+            return arrived;
+        }
+
+        uint32_t NUClearNetwork::ready_chunks(const PacketQueue& queue) const {
+            // The last chunk of a stream isn't full, so it is only ready once everything has been written
+            if (!queue.streamed || queue.written == queue.length) {
+                return queue.header.packet_count;
+            }
+            return uint32_t(queue.written / packet_data_mtu);
+        }
+
+        size_t NUClearNetwork::stream_room(const PacketQueue& queue) const {
+            // The slowest target decides how much we hold on to
+            double window = MAX_WINDOW;
+            for (const auto& t : queue.targets) {
+                auto ptr = t.target.lock();
+                if (ptr) {
+                    window = std::min(window, ptr->congestion.window);
+                }
+            }
+
+            const size_t limit    = size_t(window * 2) * packet_data_mtu;
+            const size_t buffered = queue.written - std::min(queue.written, size_t(queue.released) * packet_data_mtu);
+            return limit > buffered ? limit - buffered : 0;
+        }
+
+        void NUClearNetwork::release_chunks(PacketQueue& queue) {
+            const uint32_t ready = ready_chunks(queue);
+            while (queue.released < ready) {
+                const uint32_t chunk = queue.released;
+                const bool acked     = std::all_of(queue.targets.begin(),
+                                               queue.targets.end(),
+                                               [chunk](const PacketQueue::PacketTarget& t) {
+                                                   return (t.acked[chunk / 8] & uint8_t(1 << (chunk % 8))) != 0;
+                                               });
+                if (!acked) {
+                    break;
+                }
+                queue.chunks[chunk] = std::vector<uint8_t>();
+                ++queue.released;
+            }
+
+            // Let the writer know it can carry on
+            if (queue.on_ready && stream_room(queue) > 0) {
+                auto ready_callback = std::move(queue.on_ready);
+                queue.on_ready      = nullptr;
+                ready_callback();
+            }
+        }
+
+        void NUClearNetwork::announce() {
+
+            // Get all our targets that are global targets
+            const auto* announce_targets = name_target.find("");
+            if (announce_targets == nullptr) {
+                return;
+            }
+
+            for (const auto& t : *announce_targets) {
+
+                // Send the packet
+                if (!send_announce(t->target)) {
+                    throw std::system_error(network_errno,
+                                            std::system_category(),
+                                            "Network error when sending the announce packet");
+                }
+            }
+        }
+
+        bool NUClearNetwork::send_announce(const sock_t& to) {
+            const std::lock_guard<std::mutex> lock(groups_mutex);
+
+            // Newer first, so peers that understand it never have to upgrade us from version 2
+            for (const auto* packet : {&announce_packet_v3, &announce_packet}) {
+                if (::sendto(data_fd,
+                             reinterpret_cast<const char*>(packet->data()),
+                             static_cast<socklen_t>(packet->size()),
+                             0,
+                             &to.sock,
+                             to.size())
+                    < 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void NUClearNetwork::process_packet(const sock_t& address,
+                                            const uint8_t* payload,
+                                            const size_t payload_length) {
+
+            // First validate this is a NUClear network packet we can read (a version 2 or 3 NUClear packet)
+            if (payload_length >= sizeof(PacketHeader) && payload[0] == 0xE2 && payload[1] == 0x98 && payload[2] == 0xA2
+                && (payload[3] == V2 || payload[3] == V3)) {
+
+                // This is a real packet! get our header information
+                const PacketHeader& header = *reinterpret_cast<const PacketHeader*>(payload);
+
+                // Get the map key for this device
+                const auto key = address.key();
+
+                // From here on, we are doing things with our target lists that if changed would make us sad
+                std::shared_ptr<NetworkTarget> remote;
+                /* Mutex scope */ {
                     const std::lock_guard<std::mutex> lock(target_mutex);
-                    auto r = udp_target.find(key);
-                    remote = r == udp_target.end() ? nullptr : r->second;
+                    const auto* r = udp_target.find(key);
+                    remote        = r == nullptr ? nullptr : *r;
                 }
 
                 switch (header.type) {
 
                     // A packet announcing that a user is on the network
                     case ANNOUNCE: {
-                        // This is an announce packet!
-                        const AnnouncePacket& announce = *reinterpret_cast<const AnnouncePacket*>(payload.data());
+                        // This is an announce packet! version 3 ones have the features they support, their type
+                        // groups and the types they listen to before the name
+                        const size_t announce_length =
+                            header.version == V3 ? sizeof(AnnouncePacketV3) : sizeof(AnnouncePacket);
+                        if (payload_length < announce_length) {
+                            return;
+                        }
+                        const auto* v3         = reinterpret_cast<const AnnouncePacketV3*>(payload);
+                        const uint8_t features = header.version == V3 ? v3->features : 0;
+                        const uint8_t groups   = header.version == V3 ? v3->type_groups : 0;
 
                         // They're new!
                         if (!remote) {
-                            const std::string name(&announce.name, payload.size() - sizeof(AnnouncePacket));
+                            const std::string name(reinterpret_cast<const char*>(payload) + announce_length - 1,
+                                                   payload_length - announce_length);
 
                             // If they sent us an empty name ignore that's reserved for multicast transmissions
                             if (!name.empty()) {
                                 // Add them into our list
                                 auto ptr            = std::make_shared<NetworkTarget>(name, address);
+                                ptr->version        = header.version;
+                                ptr->features       = features;
+                                ptr->type_groups    = groups;
+                                if (header.version == V3) {
+                                    ptr->interest_version = v3->interest_version;
+                                    std::memcpy(ptr->interest.data(), v3->interest, ptr->interest.size());
+                                }
                                 bool new_connection = false;
                                 /* Mutex scope */ {
                                     const std::lock_guard<std::mutex> lock(target_mutex);
 
                                     // Double check they are new
-                                    if (udp_target.count(key) == 0) {
+                                    if (udp_target.find(key) == nullptr) {
                                         new_connection = true;
                                         targets.push_back(ptr);
-                                        udp_target.insert(std::make_pair(key, ptr));
-                                        name_target.insert(std::make_pair(name, ptr));
+                                        udp_target[key] = ptr;
+                                        name_target[name].push_back(ptr);
 
                                         // Say hi back!
-                                        ::sendto(data_fd,
-                                                 reinterpret_cast<const char*>(announce_packet.data()),
-                                                 static_cast<socklen_t>(announce_packet.size()),
-                                                 0,
-                                                 &ptr->target.sock,
-                                                 ptr->target.size());
+                                        send_announce(ptr->target);
                                     }
                                 }
 
@@ -613,6 +1597,23 @@ namespace extension {
                         // They're old but at least they're not timing out
                         else {
                             remote->last_update = std::chrono::steady_clock::now();
+
+                            // They announce in every version they understand, and we use the newest
+                            if (header.version > remote->version) {
+                                remote->version = header.version;
+                            }
+                            if (header.version == V3) {
+                                remote->type_groups = groups;
+
+                                // Announces can arrive out of order, and an older one shouldn't undo a newer interest
+                                const std::lock_guard<std::mutex> lock(target_mutex);
+                                if ((remote->features & FEATURE_INTEREST) == 0
+                                    || int16_t(v3->interest_version - remote->interest_version) >= 0) {
+                                    remote->features         = features;
+                                    remote->interest_version = v3->interest_version;
+                                    std::memcpy(remote->interest.data(), v3->interest, remote->interest.size());
+                                }
+                            }
                         }
                     } break;
                     case LEAVE: {
@@ -626,7 +1627,7 @@ namespace extension {
                                 const std::lock_guard<std::mutex> lock(target_mutex);
 
                                 // Double check they are gone after locking before removal
-                                if (udp_target.count(key) > 0) {
+                                if (udp_target.find(key) != nullptr) {
                                     left = true;
                                     remove_target(remote);
                                 }
@@ -643,12 +1644,34 @@ namespace extension {
                     case DATA_RETRANSMISSION:
                     case DATA: {
 
-                        // It's a data packet
-                        const DataPacket& packet = *reinterpret_cast<const DataPacket*>(payload.data());
+                        // It's a data packet, read its header into the version 3 layout whichever version it is
+                        DataPacketV3 packet;
+                        const size_t header_length =
+                            header.version == V3 ? sizeof(DataPacketV3) - 1 : sizeof(DataPacket) - 1;
+                        if (payload_length < header_length) {
+                            return;
+                        }
+                        if (header.version == V3) {
+                            std::memcpy(&packet, payload, header_length);
+                        }
+                        else {
+                            const DataPacket& v2 = *reinterpret_cast<const DataPacket*>(payload);
+                            packet.version       = V2;
+                            packet.type          = v2.type;
+                            packet.packet_id     = v2.packet_id;
+                            packet.packet_no     = v2.packet_no;
+                            packet.packet_count  = v2.packet_count;
+                            packet.reliable      = v2.reliable;
+                            packet.hash          = v2.hash;
+                        }
+
+                        // The chunk of data this packet carries
+                        const uint8_t* chunk = payload + header_length;
+                        const size_t length  = payload_length - header_length;
 
                         // If the packet is obviously corrupt, drop it and since we didn't ack it it'll be resent if
                         // it's important
-                        if (packet.packet_no > packet.packet_count) {
+                        if (packet.packet_no >= packet.packet_count) {
                             return;
                         }
 
@@ -658,83 +1681,95 @@ namespace extension {
                             // We got a packet from them recently
                             remote->last_update = std::chrono::steady_clock::now();
 
-                            // Check if this packet is a retransmission of data
-                            if (header.type == DATA_RETRANSMISSION) {
-
-                                // See if we recently processed this packet
-                                // NOLINTNEXTLINE(readability-qualified-auto) MSVC disagrees
-                                auto it = std::find(remote->recent_packets.begin(),
-                                                    remote->recent_packets.end(),
-                                                    packet.packet_id);
-
-                                // We recently processed this packet, this is just a failed ack
-                                // Send the ack again if it was reliable
-                                if (it != remote->recent_packets.end() && packet.reliable) {
-
-                                    // Allocate room for the whole ack packet
-                                    std::vector<uint8_t> r(sizeof(ACKPacket) + (packet.packet_count / 8), 0);
-                                    ACKPacket& response   = *reinterpret_cast<ACKPacket*>(r.data());
-                                    response              = ACKPacket();
-                                    response.packet_id    = packet.packet_id;
-                                    response.packet_no    = packet.packet_no;
-                                    response.packet_count = packet.packet_count;
-
-                                    // Set the bits for all packets (we got the whole thing)
-                                    for (int i = 0; i < packet.packet_count; ++i) {
-                                        (&response.packets)[i / 8] |= uint8_t(1 << (i % 8));
-                                    }
+                            // See if we recently processed this packet
+                            bool duplicate = false;
+                            /* Mutex Scope */ {
+                                const std::lock_guard<std::mutex> lock(remote->assemblers_mutex);
+                                duplicate = remote->recently_received(packet.version, packet.packet_id);
+                            }
+
+                            if (duplicate) {
 
-                                    // Make who we are sending it to into a useable address
-                                    const sock_t& to = remote->target;
+                                // If it is a retransmission our ack must have failed, send it again if it was reliable
+                                if (header.type == DATA_RETRANSMISSION && packet.reliable) {
+                                    send_complete_ack(*remote, packet);
+                                }
+
+                                // We don't need to process this packet we already did
+                                return;
+                            }
 
-                                    // Send the packet
-                                    ::sendto(data_fd,
-                                             reinterpret_cast<const char*>(r.data()),
-                                             static_cast<socklen_t>(r.size()),
-                                             0,
-                                             &to.sock,
-                                             to.size());
+                            // If nobody wants this type of packet don't bother copying or assembling it
+                            if (packet_filter && !packet_filter(packet.hash)) {
 
-                                    // We don't need to process this packet we already did
-                                    return;
+                                // Version 3 peers know which types we listen to so don't wait for us to acknowledge
+                                // the rest, if they hadn't heard yet they send it again and we acknowledge that one
+                                if (header.type == DATA && advertise_interest && remote->version >= V3) {
+                                    const std::lock_guard<std::mutex> lock(groups_mutex);
+                                    if (!interest.contains(packet.hash)) {
+                                        return;
+                                    }
+                                }
+
+                                // Reliable packets are still acknowledged in full so the sender stops sending them
+                                // One ack is enough, if it is lost the retransmissions are acked as a recent packet
+                                if (packet.reliable) {
+                                    send_complete_ack(*remote, packet);
+
+                                    // Remember it so any retransmissions that were already in flight are acked again
+                                    const std::lock_guard<std::mutex> lock(remote->assemblers_mutex);
+                                    remote->mark_received(packet.version, packet.packet_id);
                                 }
+                                return;
+                            }
+
+                            // Don't let a corrupt chunk make us allocate more than the largest packet we accept
+                            // Version 2 chunks don't tell us the total length, but any chunk except the last gives it
+                            // to within a chunk
+                            const bool last      = packet.packet_no + 1 == packet.packet_count;
+                            const uint64_t limit = max_message_size;
+                            const uint64_t total = packet.version == V3 ? packet.length
+                                                   : last               ? length
+                                                                        : uint64_t(packet.packet_count) * length;
+                            if (limit > 0 && total > limit) {
+                                return;
                             }
 
                             // If this is a solo packet (in a single chunk)
                             if (packet.packet_count == 1) {
 
                                 // Copy our data into a vector
-                                std::vector<uint8_t> out(&packet.data,
-                                                         &packet.data + payload.size() - sizeof(DataPacket) + 1);
+                                std::vector<uint8_t> out(chunk, chunk + length);
 
                                 // If this is a reliable packet, send an ack back
                                 if (packet.reliable) {
-                                    // This response is easy since there is only one packet
-                                    ACKPacket response;
-                                    response.packet_id    = packet.packet_id;
-                                    response.packet_no    = packet.packet_no;
-                                    response.packet_count = packet.packet_count;
-                                    response.packets      = 1;
-
-                                    // Make who we are sending it to into a useable address
-                                    const sock_t& to = remote->target;
-
-                                    ::sendto(data_fd,
-                                             reinterpret_cast<const char*>(&response),
-                                             sizeof(response),
-                                             0,
-                                             &to.sock,
-                                             to.size());
-
-                                    // Set this packet to have been recently received
-                                    remote->recent_packets[remote->recent_packets_index
-                                                               .fetch_add(1, std::memory_order_relaxed)] =
-                                        packet.packet_id;
+                                    send_complete_ack(*remote, packet);
+                                }
+
+                                // Set this packet to have been recently received so any copies of it are dropped
+                                /* Mutex Scope */ {
+                                    const std::lock_guard<std::mutex> lock(remote->assemblers_mutex);
+                                    remote->mark_received(packet.version, packet.packet_id);
                                 }
 
-                                packet_callback(*remote, packet.hash, packet.reliable, std::move(out));
+                                // If it was compressed and can't be decompressed there is nothing we can pass on
+                                if (decompress(packet.compression, out)) {
+                                    packet_callback(*remote, packet.hash, packet.reliable, std::move(out));
+                                }
                             }
                             else {
+                                const size_t bitmap_len = (size_t(packet.packet_count) + 7) / 8;
+
+                                // Version 3 chunks tell us the total length, so any of them tells us the stride
+                                size_t stride = 0;
+                                if (packet.version == V3) {
+                                    stride =
+                                        util::network::chunk_stride(packet.length, packet.packet_count, last, length);
+                                    if (stride == 0) {
+                                        return;
+                                    }
+                                }
+
                                 const std::lock_guard<std::mutex> lock(remote->assemblers_mutex);
 
                                 // Grab the payload and put it in our list of assemblers targets
@@ -742,112 +1777,164 @@ namespace extension {
 
                                 auto& assembler = assemblers[packet.packet_id];
 
-                                // First check that our cache isn't super corrupted by ensuring that our last packet
-                                // in our list isn't after the number of packets we have
-                                if (!assembler.second.empty()
-                                    && std::next(assembler.second.end(), -1)->first >= packet.packet_count) {
+                                // First check that our cache isn't super corrupted by ensuring that this chunk agrees
+                                // with the ones we already have about how many chunks there are and how big they are
+                                if (assembler.received_count > 0
+                                    && (assembler.version != packet.version
+                                        || assembler.packet_count != packet.packet_count
+                                        || (packet.version == V3
+                                            && (assembler.length != packet.length || assembler.stride != stride))
+                                        || (packet.version == V2
+                                            && ((!last && assembler.stride != 0 && length != assembler.stride)
+                                                || (!last && assembler.stride == 0 && assembler.tail.size() > length)
+                                                || (last && assembler.stride != 0 && length > assembler.stride))))) {
 
                                     // If so, we need to purge our cache and if this was a reliable packet, send a
                                     // NACK back for all the packets we thought we had
                                     // We don't know if we have any packets except the one we just got
                                     if (packet.reliable) {
-
-                                        // A basic ack has room for 8 packets and we need 1 extra byte for each 8
-                                        // additional packets
-                                        std::vector<uint8_t> r(sizeof(NACKPacket) + (packet.packet_count / 8), 0);
-                                        NACKPacket& response  = *reinterpret_cast<NACKPacket*>(r.data());
-                                        response              = NACKPacket();
-                                        response.packet_id    = packet.packet_id;
-                                        response.packet_count = packet.packet_count;
-
-                                        // Set the bits for the packets we thought we received
-                                        for (const auto& p : assembler.second) {
-                                            (&response.packets)[p.first / 8] |= uint8_t(1 << (p.first % 8));
-                                        }
+                                        std::vector<uint8_t> lost(bitmap_len, 0);
+                                        std::memcpy(lost.data(),
+                                                    assembler.received.data(),
+                                                    std::min(assembler.received.size(), bitmap_len));
 
                                         // Ensure the bit for this packet isn't NACKed
-                                        (&response.packets)[packet.packet_no / 8] &=
-                                            ~uint8_t(1 << (packet.packet_no % 8));
-
-                                        // Make who we are sending it to into a useable address
-                                        const sock_t& to = remote->target;
-
-                                        // Send the packet
-                                        ::sendto(data_fd,
-                                                 reinterpret_cast<const char*>(r.data()),
-                                                 static_cast<socklen_t>(r.size()),
-                                                 0,
-                                                 &to.sock,
-                                                 to.size());
+                                        lost[packet.packet_no / 8] &= ~uint8_t(1 << (packet.packet_no % 8));
+
+                                        send_nack(*remote, packet, lost);
                                     }
 
                                     // Clear our packets here (the one we just got will be added right after this)
-                                    assembler.second.clear();
+                                    assembler = NetworkTarget::Assembler();
                                 }
 
-                                // Add our packet to our list of assemblers
-                                assembler.first                    = std::chrono::steady_clock::now();
-                                assembler.second[packet.packet_no] = std::move(payload);
+                                // Start tracking a new packet
+                                if (assembler.received_count == 0) {
+                                    assembler.version      = packet.version;
+                                    assembler.packet_count = packet.packet_count;
+                                    assembler.received.assign(bitmap_len, 0);
+                                    // Compressed packets can't be streamed as they need all of their data first
+                                    assembler.streamed = packet.reliable && packet.compression == COMPRESSION_NONE
+                                                         && stream_callback && stream_filter
+                                                         && stream_filter(packet.hash);
+
+                                    // Knowing the total length means the whole packet can be allocated straight away
+                                    if (packet.version == V3) {
+                                        assembler.length      = packet.length;
+                                        assembler.stride      = stride;
+                                        assembler.last_length = size_t(packet.length % stride);
+                                        if (!assembler.streamed) {
+                                            assembler.data.resize(size_t(packet.length));
+                                        }
+                                    }
+                                }
+                                assembler.last_chunk = std::chrono::steady_clock::now();
+
+                                // If this chunk is past the next one we expected, the ones in between went missing
+                                const bool skipped   = packet.packet_no > assembler.next_chunk;
+                                assembler.next_chunk = std::max(assembler.next_chunk, uint32_t(packet.packet_no + 1));
+
+                                // Put our chunk in its place unless we already have it
+                                uint8_t& bits     = assembler.received[packet.packet_no / 8];
+                                const uint8_t bit = uint8_t(1 << (packet.packet_no % 8));
+                                if ((bits & bit) == 0) {
+                                    bits |= bit;
+                                    ++assembler.received_count;
+
+                                    // Streamed packets hand over each chunk as soon as the ones before it have arrived
+                                    if (assembler.streamed) {
+                                        if (!last && assembler.stride == 0) {
+                                            assembler.stride = length;
+                                        }
 
-                                // Create and send our ACK packet if this is a reliable transmission
-                                if (packet.reliable) {
-                                    // A basic ack has room for 8 packets and we need 1 extra byte for each 8
-                                    // additional packets
-                                    std::vector<uint8_t> r(sizeof(ACKPacket) + (packet.packet_count / 8), 0);
-                                    ACKPacket& response   = *reinterpret_cast<ACKPacket*>(r.data());
-                                    response              = ACKPacket();
-                                    response.packet_id    = packet.packet_id;
-                                    response.packet_no    = packet.packet_no;
-                                    response.packet_count = packet.packet_count;
-
-                                    // Set the bits for the packets we have received
-                                    for (const auto& p : assembler.second) {
-                                        (&response.packets)[p.first / 8] |= uint8_t(1 << (p.first % 8));
+                                        if (packet.packet_no == assembler.delivered) {
+                                            std::vector<uint8_t> piece(chunk, chunk + length);
+                                            for (;;) {
+                                                const bool end = ++assembler.delivered == packet.packet_count;
+                                                stream_callback(*remote,
+                                                                packet.hash,
+                                                                packet.packet_id,
+                                                                std::move(piece),
+                                                                end);
+
+                                                // Anything that was waiting on this chunk can go now too
+                                                auto next = assembler.waiting.find(assembler.delivered);
+                                                if (next == assembler.waiting.end()) {
+                                                    break;
+                                                }
+                                                piece = std::move(next->second);
+                                                assembler.waiting.erase(next);
+                                            }
+                                        }
+                                        else {
+                                            assembler.waiting.emplace(uint32_t(packet.packet_no),
+                                                                      std::vector<uint8_t>(chunk, chunk + length));
+                                        }
+                                    }
+                                    // Any chunk but the last tells us the stride, so the whole packet can be allocated
+                                    else if (!last && assembler.stride == 0) {
+                                        assembler.stride = length;
+                                        assembler.data.resize(size_t(packet.packet_count) * length);
+
+                                        // If the last chunk beat us here it can go in its place now
+                                        if (!assembler.tail.empty()) {
+                                            const size_t before = packet.packet_count - 1;
+                                            std::memcpy(assembler.data.data() + before * length,
+                                                        assembler.tail.data(),
+                                                        assembler.tail.size());
+                                            assembler.tail = std::vector<uint8_t>();
+                                        }
                                     }
 
-                                    // Make who we are sending it to into a useable address
-                                    const sock_t& to = remote->target;
+                                    if (last) {
+                                        assembler.last_length = length;
+                                    }
 
-                                    // Send the packet
-                                    ::sendto(data_fd,
-                                             reinterpret_cast<const char*>(r.data()),
-                                             static_cast<socklen_t>(r.size()),
-                                             0,
-                                             &to.sock,
-                                             to.size());
+                                    // Write the chunk straight to where it lives in the final packet
+                                    if (!assembler.streamed && assembler.stride != 0) {
+                                        std::memcpy(assembler.data.data() + size_t(packet.packet_no) * assembler.stride,
+                                                    chunk,
+                                                    length);
+                                    }
+                                    else if (!assembler.streamed) {
+                                        assembler.tail.assign(chunk, chunk + length);
+                                    }
                                 }
 
-                                // Check to see if we have enough to assemble the whole thing
-                                if (assembler.second.size() == packet.packet_count) {
-
-                                    // Work out exactly how much data we will need first so we only need one
-                                    // allocation
-                                    size_t payload_size = 0;
-                                    for (const auto& p : assembler.second) {
-                                        payload_size += p.second.size() - sizeof(DataPacket) + 1;
+                                // Acks are held back so one covers many chunks, but the sender needs to hear straight
+                                // away when the packet is complete or when chunks were skipped over and are missing
+                                if (packet.reliable) {
+                                    ++assembler.unacked;
+                                    if (skipped || assembler.unacked >= ACK_EVERY
+                                        || assembler.received_count == packet.packet_count) {
+                                        send_ack(*remote, packet.packet_id, assembler);
                                     }
-
-                                    // Read in our data
-                                    std::vector<uint8_t> out;
-                                    out.reserve(payload_size);
-                                    for (auto& p : assembler.second) {
-                                        const DataPacket& part = *reinterpret_cast<DataPacket*>(p.second.data());
-                                        out.insert(out.end(),
-                                                   &part.data,
-                                                   &part.data + p.second.size() - sizeof(DataPacket) + 1);
+                                    else if (assembler.ack_due == std::chrono::steady_clock::time_point::max()) {
+                                        assembler.ack_due =
+                                            assembler.last_chunk + std::chrono::milliseconds(int(ACK_DELAY));
+                                        schedule_ack(assembler.ack_due);
                                     }
+                                }
 
-                                    // Send our assembled data packet
-                                    packet_callback(*remote, packet.hash, packet.reliable, std::move(out));
+                                // Check to see if we have the whole thing
+                                if (assembler.received_count == packet.packet_count) {
 
-                                    // If the packet was reliable add that it was recently received
-                                    if (packet.reliable) {
-                                        // Set this packet to have been recently received
-                                        remote->recent_packets[remote->recent_packets_index
-                                                                   .fetch_add(1, std::memory_order_relaxed)] =
-                                            packet.packet_id;
+                                    // Streamed packets have already been handed over piece by piece
+                                    if (!assembler.streamed) {
+                                        // Every chunk is already in place, we just trim the unused end of the last one
+                                        std::vector<uint8_t> out = std::move(assembler.data);
+                                        const size_t before      = packet.packet_count - 1;
+                                        out.resize(before * assembler.stride + assembler.last_length);
+
+                                        // Send our assembled data packet once it is decompressed
+                                        if (decompress(packet.compression, out)) {
+                                            packet_callback(*remote, packet.hash, packet.reliable, std::move(out));
+                                        }
                                     }
 
+                                    // Set this packet to have been recently received so any copies of it are dropped
+                                    remote->mark_received(packet.version, packet.packet_id);
+
                                     // We have completed this packet, discard the data
                                     assemblers.erase(assemblers.find(packet.packet_id));
                                 }
@@ -855,8 +1942,11 @@ namespace extension {
                                 // Check for and delete any timed out packets
                                 for (auto it = assemblers.begin(); it != assemblers.end();) {
                                     const auto now              = std::chrono::steady_clock::now();
-                                    const auto timeout          = remote->round_trip_time * 10.0;
-                                    const auto& last_chunk_time = it->second.first;
+                                    const auto timeout          = std::max<std::chrono::steady_clock::duration>(
+                                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                            remote->round_trip_time * 10.0),
+                                        std::chrono::milliseconds(int(ASSEMBLY_TIMEOUT)));
+                                    const auto& last_chunk_time = it->second.last_chunk;
 
                                     it = now > last_chunk_time + timeout ? assemblers.erase(it) : std::next(it);
                                 }
@@ -867,22 +1957,54 @@ namespace extension {
                     // Packet acknowledging the receipt of a packet of data
                     case ACK: {
 
-                        // It's an ack packet
-                        const ACKPacket& packet = *reinterpret_cast<const ACKPacket*>(payload.data());
-
                         // Check if we know who this is and if we don't know them, ignore
                         if (remote) {
 
+                            // Work out which bytes of the packet's bitsets the ack covers
+                            // A version 2 ack has the whole bitset, version 3 has a slice of it and everything below
+                            // received_below has arrived
+                            uint32_t packet_id      = 0;
+                            uint32_t packet_count   = 0;
+                            uint32_t received_below = 0;
+                            size_t offset           = 0;
+                            size_t size             = 0;
+                            const uint8_t* bits     = nullptr;
+                            if (header.version == V3 && payload_length >= sizeof(ACKPacketV3) - 1) {
+                                const ACKPacketV3& packet = *reinterpret_cast<const ACKPacketV3*>(payload);
+                                packet_id                 = packet.packet_id;
+                                packet_count              = packet.packet_count;
+                                received_below            = packet.received_below;
+                                offset                    = packet.offset / 8;
+                                size                      = payload_length - (sizeof(ACKPacketV3) - 1);
+                                bits                      = &packet.packets;
+
+                                // Slices always start on a byte
+                                if (packet.offset % 8 != 0 || received_below > packet_count) {
+                                    return;
+                                }
+                            }
+                            else if (header.version == V2 && payload_length >= sizeof(ACKPacket)) {
+                                const ACKPacket& packet = *reinterpret_cast<const ACKPacket*>(payload);
+                                packet_id               = packet.packet_id;
+                                packet_count            = packet.packet_count;
+                                size                    = payload_length - sizeof(ACKPacket) + 1;
+                                bits                    = &packet.packets;
+                            }
+                            else {
+                                return;
+                            }
+
                             // We got a packet from them recently
                             remote->last_update = std::chrono::steady_clock::now();
 
                             // lock the send queue mutex
                             const std::lock_guard<std::mutex> send_lock(send_queue_mutex);
 
-                            // Check for our packet id in the send queue
-                            if (send_queue.count(packet.packet_id) > 0) {
+                            // Check for our packet id in the send queue, it has to be the version we sent it as
+                            PacketQueue* found = send_queue.find(packet_id);
+                            if (found != nullptr && found->header.version == header.version) {
 
-                                auto& queue = send_queue[packet.packet_id];
+                                auto& queue = *found;
 
                                 // Find this target in the send queue
                                 auto s = std::find_if(queue.targets.begin(),
@@ -895,9 +2017,10 @@ namespace extension {
                                 // From an unknown person
                                 if (s != queue.targets.end()
                                     // Wrong packet
-                                    && packet.packet_count == queue.header.packet_count
-                                    // Truncated packet
-                                    && payload.size() == (sizeof(ACKPacket) + (queue.header.packet_count / 8))) {
+                                    && packet_count == queue.header.packet_count
+                                    // Truncated packet, version 2 acks have every byte and version 3 acks fit inside
+                                    && (header.version == V2 ? size == s->acked.size()
+                                                             : offset + size <= s->acked.size())) {
 
                                     // Work out about how long our round trip time is
                                     auto now        = std::chrono::steady_clock::now();
@@ -907,31 +2030,67 @@ namespace extension {
                                     // long before retransmitting
                                     // We use a baby kalman filter to help smooth out jitter
                                     remote->measure_round_trip(round_trip);
+                                    remote->congestion.latest_round_trip = round_trip;
 
-                                    // Update our acks
-                                    bool all_acked = true;
-                                    for (unsigned i = 0; i < s->acked.size(); ++i) {
-
-                                        // Update our bitset
-                                        s->acked[i] |= (&packet.packets)[i];
-
-                                        // Work out what a "fully acked" packet would look like
-                                        const uint8_t expected = i + 1 < s->acked.size() || packet.packet_count % 8 == 0
-                                                                     ? 0xFF
-                                                                     : 0xFF >> (8 - (packet.packet_count % 8));
+                                    // If that brought forward when we should resend to them, look at it sooner
+                                    const auto timeout = s->last_send + remote->round_trip_time;
+                                    if (timeout < queue.next_check) {
+                                        schedule_retransmit(queue, timeout);
+                                    }
 
-                                        all_acked &= static_cast<int>((s->acked[i] & expected) == expected);
+                                    // Update our acks, first everything below where they have all arrived and then
+                                    // the chunks in the bitset
+                                    size_t arrived = 0;
+                                    if (received_below > s->acked_below) {
+                                        const size_t begin = s->acked_below / 8;
+                                        const size_t end =
+                                            received_below == packet_count ? s->acked.size() : received_below / 8;
+                                        arrived +=
+                                            ack_chunks(*s, queue.paced, packet_count, begin, nullptr, end - begin);
+                                        s->acked_below = received_below == packet_count ? packet_count
+                                                                                        : uint32_t(end * 8);
+                                    }
+                                    arrived += ack_chunks(*s, queue.paced, packet_count, offset, bits, size);
+
+                                    // Grow the window by a datagram for each one that arrived until we pass the
+                                    // threshold, and by about one datagram each round trip after that
+                                    if (queue.paced) {
+                                        auto& cc = remote->congestion;
+                                        cc.in_flight -= std::min(cc.in_flight, arrived);
+                                        if (arrived > 0) {
+                                            s->last_ack = now;
+                                        }
+                                        for (size_t n = 0; n < arrived; ++n) {
+                                            cc.window += cc.window < cc.threshold ? 1.0 : 1.0 / cc.window;
+                                        }
+                                        cc.window = std::min(cc.window, double(MAX_WINDOW));
                                     }
 
                                     // The remote has received this entire packet we can erase our sender
-                                    if (all_acked) {
+                                    bool finished = false;
+                                    if (s->acked_count == packet_count) {
+                                        queue.latency.emplace_back(s->name, now - queue.first_send);
                                         queue.targets.erase(s);
 
                                         // If we're all done remove the whole thing
                                         if (queue.targets.empty()) {
-                                            send_queue.erase(packet.packet_id);
+                                            complete(queue, "");
+                                            send_queue.erase(packet_id);
+                                            finished = true;
                                         }
                                     }
+
+                                    // Streams don't need to keep what every target has, which may make room for more
+                                    if (!finished && queue.streamed) {
+                                        release_chunks(queue);
+                                    }
+
+                                    // Use the room in the window to send more of what is waiting
+                                    if (!remote->congestion.pending.empty()) {
+                                        std::vector<Datagram> datagrams;
+                                        pump(remote, datagrams, now);
+                                        transmit(datagrams);
+                                    }
                                 }
                             }
                         }
@@ -939,20 +2098,53 @@ namespace extension {
 
                     // Packet requesting a retransmission of some corrupt data
                     case NACK: {
-                        // It's a nack packet
-                        const NACKPacket& packet = *reinterpret_cast<const NACKPacket*>(payload.data());
 
                         // Check if we know who this is and if we don't know them, ignore
                         if (remote) {
 
+                            // Work out which bytes of the packet's bitsets the nack covers
+                            // A version 2 nack has the whole bitset, version 3 has a slice of it
+                            uint32_t packet_id    = 0;
+                            uint32_t packet_count = 0;
+                            size_t offset         = 0;
+                            size_t size           = 0;
+                            const uint8_t* bits   = nullptr;
+                            if (header.version == V3 && payload_length >= sizeof(NACKPacketV3) - 1) {
+                                const NACKPacketV3& packet = *reinterpret_cast<const NACKPacketV3*>(payload);
+                                packet_id                  = packet.packet_id;
+                                packet_count               = packet.packet_count;
+                                offset                     = packet.offset / 8;
+                                size                       = payload_length - (sizeof(NACKPacketV3) - 1);
+                                bits                       = &packet.packets;
+
+                                // Slices always start on a byte
+                                if (packet.offset % 8 != 0) {
+                                    return;
+                                }
+                            }
+                            else if (header.version == V2 && payload_length >= sizeof(NACKPacket)) {
+                                const NACKPacket& packet = *reinterpret_cast<const NACKPacket*>(payload);
+                                packet_id                = packet.packet_id;
+                                packet_count             = packet.packet_count;
+                                size                     = payload_length - sizeof(NACKPacket) + 1;
+                                bits                     = &packet.packets;
+                            }
+                            else {
+                                return;
+                            }
+
                             // We got a packet from them recently
                             remote->last_update = std::chrono::steady_clock::now();
 
-                            // Check for our packet id in the send queue
-                            if (send_queue.count(packet.packet_id) > 0) {
+                            // lock the send queue mutex
+                            const std::lock_guard<std::mutex> send_lock(send_queue_mutex);
+
+                            // Check for our packet id in the send queue, it has to be the version we sent it as
+                            PacketQueue* found = send_queue.find(packet_id);
+                            if (found != nullptr && found->header.version == header.version) {
 
                                 // Find this packet in our sending queue
-                                auto& queue = send_queue[packet.packet_id];
+                                auto& queue = *found;
 
                                 // Find this target in the send queue
                                 auto s = std::find_if(queue.targets.begin(),
@@ -965,36 +2157,69 @@ namespace extension {
                                 // We know who it is
                                 if (s != queue.targets.end()
                                     // It's not corrupted
-                                    && packet.packet_count == queue.header.packet_count
-                                    // It's not truncated
-                                    && payload.size() == (sizeof(NACKPacket) + (queue.header.packet_count / 8))) {
+                                    && packet_count == queue.header.packet_count
+                                    // It's not truncated, version 2 nacks have every byte and version 3 ones fit inside
+                                    && (header.version == V2 ? size == s->acked.size()
+                                                             : offset + size <= s->acked.size())) {
 
                                     // Store the time as we are now sending new packets
                                     s->last_send = std::chrono::steady_clock::now();
 
                                     // The next time we should check for a timeout
-                                    auto next_timeout = s->last_send + remote->round_trip_time;
-                                    if (next_timeout < next_event) {
-                                        next_event = next_timeout;
-                                        next_event_callback(next_event);
+                                    const auto timeout = s->last_send + remote->round_trip_time;
+                                    if (timeout < queue.next_check) {
+                                        schedule_retransmit(queue, timeout);
                                     }
 
-                                    // Update our acks with the nacked data
-                                    for (unsigned i = 0; i < s->acked.size(); ++i) {
-
-                                        // Update our bitset
-                                        s->acked[i] &= ~(&packet.packets)[i];
+                                    // A stream can't send again what it has already freed, so it can't be delivered
+                                    bool freed         = false;
+                                    const size_t below = queue.streamed ? (size_t(queue.released) + 7) / 8 : 0;
+                                    for (size_t i = offset; i < std::min(offset + size, below); ++i) {
+                                        const size_t n = std::min<size_t>(queue.released - i * 8, 8);
+                                        freed |= (bits[i - offset] & uint8_t((1 << n) - 1)) != 0;
                                     }
+                                    if (freed) {
+                                        for (const auto& t : queue.targets) {
+                                            auto ptr = t.target.lock();
+                                            if (ptr) {
+                                                auto& cc = ptr->congestion;
+                                                cc.in_flight -= std::min(cc.in_flight, count_bits(t.sent));
+                                            }
+                                        }
+                                        complete(queue,
+                                                 "Target " + s->name + " lost data the stream had already released");
+                                        send_queue.erase(packet_id);
+                                        return;
+                                    }
+
+                                    // Update our acks with the nacked data
+                                    for (size_t i = offset; i < offset + size; ++i) {
+                                        const uint8_t lost = s->acked[i] & bits[i - offset];
+                                        s->acked_count -= uint32_t(count_bits(lost));
+                                        s->acked[i] &= uint8_t(~lost);
+                                    }
+                                    s->acked_below = std::min(s->acked_below, uint32_t(offset * 8));
 
                                     // Now we have to retransmit the nacked packets
-                                    for (uint16_t i = 0; i < packet.packet_count * 8; ++i) {
+                                    std::vector<Datagram> datagrams;
 
-                                        // Check if this packet needs to be sent
-                                        const uint8_t bit = 1 << (i % 8);
-                                        if (((&packet.packets)[i] & bit) == bit) {
-                                            send_packet(remote->target, queue.header, i, queue.payload, true);
+                                    // Paced packets are sent again as the window allows
+                                    if (queue.paced) {
+                                        lose_chunks(*remote, queue, *s, bits, offset, size);
+                                        pump(remote, datagrams, s->last_send);
+                                    }
+                                    else {
+                                        const size_t end = std::min(size_t(packet_count), (offset + size) * 8);
+                                        for (uint32_t i = uint32_t(offset * 8); i < end; ++i) {
+
+                                            // Check if this packet needs to be sent
+                                            const uint8_t bit = 1 << (i % 8);
+                                            if ((bits[i / 8 - offset] & bit) == bit) {
+                                                add_datagram(datagrams, remote->target, queue, queue.header, i);
+                                            }
                                         }
                                     }
+                                    transmit(datagrams);
                                 }
                             }
                         }
@@ -1004,69 +2229,876 @@ namespace extension {
         }
 
 
+        void NUClearNetwork::send_ack(const NetworkTarget& target,
+                                      uint32_t packet_id,
+                                      NetworkTarget::Assembler& assembler) {
+
+            std::vector<uint8_t> r;
+            if (assembler.version == V3) {
+
+                // Everything before the first byte with a chunk missing has arrived
+                const auto& received = assembler.received;
+                while (assembler.ack_base < received.size() && received[assembler.ack_base] == 0xFF) {
+                    ++assembler.ack_base;
+                }
+
+                // The bitset runs from there to the newest chunk, if that doesn't fit we keep the newest part as the
+                // sender needs to hear about what it sent most recently
+                const size_t end   = (size_t(assembler.next_chunk) + 7) / 8;
+                const size_t begin = std::max(assembler.ack_base, end - std::min(end, size_t(MAX_ACK_BITSET)));
+
+                r.resize(sizeof(ACKPacketV3) + (end - begin), 0);
+                ACKPacketV3& response   = *reinterpret_cast<ACKPacketV3*>(r.data());
+                response                = ACKPacketV3();
+                response.packet_id      = packet_id;
+                response.packet_count   = assembler.packet_count;
+                response.received_below = assembler.received_count == assembler.packet_count
+                                              ? assembler.packet_count
+                                              : uint32_t(assembler.ack_base * 8);
+                response.offset         = uint32_t(begin * 8);
+                std::memcpy(&response.packets, received.data() + begin, end - begin);
+                r.pop_back();
+            }
+            else {
+                // A basic ack has room for 8 packets and we need 1 extra byte for each 8 additional packets
+                r.resize(sizeof(ACKPacket) + (assembler.packet_count / 8), 0);
+                ACKPacket& response   = *reinterpret_cast<ACKPacket*>(r.data());
+                response              = ACKPacket();
+                response.packet_id    = uint16_t(packet_id);
+                response.packet_no    = uint16_t(assembler.next_chunk - 1);
+                response.packet_count = uint16_t(assembler.packet_count);
+
+                // Set the bits for the packets we have received
+                std::memcpy(&response.packets, assembler.received.data(), assembler.received.size());
+            }
+
+            // Send the packet
+            ::sendto(data_fd,
+                     reinterpret_cast<const char*>(r.data()),
+                     static_cast<socklen_t>(r.size()),
+                     0,
+                     &target.target.sock,
+                     target.target.size());
+            ++acks_sent;
+
+            // Everything that has arrived is covered now
+            assembler.unacked = 0;
+            assembler.ack_due = std::chrono::steady_clock::time_point::max();
+        }
+
+        void NUClearNetwork::send_complete_ack(const NetworkTarget& target, const DataPacketV3& packet) {
+
+            std::vector<uint8_t> r;
+            if (packet.version == V3) {
+                // Saying everything is below the packet count covers it without any bitset
+                r.resize(sizeof(ACKPacketV3), 0);
+                ACKPacketV3& response   = *reinterpret_cast<ACKPacketV3*>(r.data());
+                response                = ACKPacketV3();
+                response.packet_id      = packet.packet_id;
+                response.packet_count   = packet.packet_count;
+                response.received_below = packet.packet_count;
+                r.pop_back();
+            }
+            else {
+                // Allocate room for the whole ack packet
+                r.resize(sizeof(ACKPacket) + (packet.packet_count / 8), 0);
+                ACKPacket& response   = *reinterpret_cast<ACKPacket*>(r.data());
+                response              = ACKPacket();
+                response.packet_id    = uint16_t(packet.packet_id);
+                response.packet_no    = uint16_t(packet.packet_no);
+                response.packet_count = uint16_t(packet.packet_count);
+
+                // Set the bits for all packets
+                for (uint32_t i = 0; i < packet.packet_count; ++i) {
+                    (&response.packets)[i / 8] |= uint8_t(1 << (i % 8));
+                }
+            }
+
+            // Send the packet
+            ::sendto(data_fd,
+                     reinterpret_cast<const char*>(r.data()),
+                     static_cast<socklen_t>(r.size()),
+                     0,
+                     &target.target.sock,
+                     target.target.size());
+            ++acks_sent;
+        }
+
+        void NUClearNetwork::send_nack(const NetworkTarget& target,
+                                       const DataPacketV3& packet,
+                                       const std::vector<uint8_t>& lost) {
+
+            // Version 2 nacks carry the whole bitset, version 3 nacks split it over as many as it takes
+            const size_t slice = packet.version == V3 ? size_t(MAX_ACK_BITSET) : lost.size();
+            for (size_t offset = 0; offset < lost.size(); offset += slice) {
+                const size_t size = std::min(slice, lost.size() - offset);
+
+                // Parts of a version 3 bitset with nothing to resend don't need to be sent at all
+                const auto first = lost.begin() + std::ptrdiff_t(offset);
+                const auto last  = first + std::ptrdiff_t(size);
+                if (packet.version == V3 && std::all_of(first, last, [](uint8_t b) { return b == 0; })) {
+                    continue;
+                }
+
+                std::vector<uint8_t> r;
+                if (packet.version == V3) {
+                    r.resize(sizeof(NACKPacketV3) + size, 0);
+                    NACKPacketV3& response = *reinterpret_cast<NACKPacketV3*>(r.data());
+                    response               = NACKPacketV3();
+                    response.packet_id     = packet.packet_id;
+                    response.packet_count  = packet.packet_count;
+                    response.offset        = uint32_t(offset * 8);
+                    std::memcpy(&response.packets, lost.data() + offset, size);
+                    r.pop_back();
+                }
+                else {
+                    // A basic nack has room for 8 packets and we need 1 extra byte for each 8 additional packets
+                    r.resize(sizeof(NACKPacket) + (packet.packet_count / 8), 0);
+                    NACKPacket& response  = *reinterpret_cast<NACKPacket*>(r.data());
+                    response              = NACKPacket();
+                    response.packet_id    = uint16_t(packet.packet_id);
+                    response.packet_count = uint16_t(packet.packet_count);
+                    std::memcpy(&response.packets, lost.data(), size);
+                }
+
+                // Send the packet
+                ::sendto(data_fd,
+                         reinterpret_cast<const char*>(r.data()),
+                         static_cast<socklen_t>(r.size()),
+                         0,
+                         &target.target.sock,
+                         target.target.size());
+            }
+        }
+
+        void NUClearNetwork::schedule_ack(std::chrono::steady_clock::time_point when) {
+            // Only ever bring the deadline forward, another thread may have just set an earlier one
+            const std::chrono::steady_clock::rep ticks = when.time_since_epoch().count();
+            std::chrono::steady_clock::rep current     = next_ack.load();
+            while (ticks < current && !next_ack.compare_exchange_weak(current, ticks)) {
+            }
+
+            // Make sure we are woken up in time
+            const std::lock_guard<std::mutex> lock(send_queue_mutex);
+            if (when < next_event) {
+                next_event = when;
+                next_event_callback(next_event);
+            }
+        }
+
+        void NUClearNetwork::flush_acks() {
+
+            // Any acks that aren't due yet will be scheduled again
+            next_ack = std::chrono::steady_clock::time_point::max().time_since_epoch().count();
+
+            std::vector<std::shared_ptr<NetworkTarget>> remotes;
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(target_mutex);
+                remotes.assign(targets.begin(), targets.end());
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            auto next      = std::chrono::steady_clock::time_point::max();
+            for (const auto& remote : remotes) {
+                const std::lock_guard<std::mutex> lock(remote->assemblers_mutex);
+                for (auto& a : remote->assemblers) {
+                    if (a.second.ack_due <= now) {
+                        send_ack(*remote, a.first, a.second);
+                    }
+                    else {
+                        next = std::min(next, a.second.ack_due);
+                    }
+                }
+            }
+
+            if (next != std::chrono::steady_clock::time_point::max()) {
+                schedule_ack(next);
+            }
+        }
+
         std::vector<fd_t> NUClearNetwork::listen_fds() {
             return std::vector<fd_t>({data_fd, announce_fd});
         }
 
-        void NUClearNetwork::send_packet(const sock_t& target,
-                                         NUClear::extension::network::DataPacket header,
-                                         uint16_t packet_no,
-                                         const std::vector<uint8_t>& payload,
-                                         const bool& /*reliable*/) {
+        NUClearNetwork::Datagram NUClearNetwork::make_datagram(const sock_t& target,
+                                                               const DataPacketV3& header,
+                                                               uint32_t packet_no) const {
+            Datagram d;
+            d.target = &target;
+
+            // Write the header out in the version the packet is being sent as
+            if (header.version == V3) {
+                DataPacketV3 h  = header;
+                h.packet_no     = packet_no;
+                d.header_length = sizeof(DataPacketV3) - 1;
+                std::memcpy(d.header.data(), &h, d.header_length);
+            }
+            else {
+                DataPacket h;
+                h.type          = header.type;
+                h.packet_id     = uint16_t(header.packet_id);
+                h.packet_no     = uint16_t(packet_no);
+                h.packet_count  = uint16_t(header.packet_count);
+                h.reliable      = header.reliable;
+                h.hash          = header.hash;
+                d.header_length = sizeof(DataPacket) - 1;
+                std::memcpy(d.header.data(), &h, d.header_length);
+            }
 
-            // Our packet we are sending
-            msghdr message{};
+            return d;
+        }
 
-            std::array<iovec, 2> data{};
-            message.msg_iov    = data.data();
-            message.msg_iovlen = 2;
+        void NUClearNetwork::add_datagram(std::vector<Datagram>& datagrams,
+                                          const sock_t& target,
+                                          const DataPacketV3& header,
+                                          uint32_t packet_no,
+                                          const uint8_t* payload,
+                                          const size_t& length) const {
 
-            // Update our headers packet number and set it in the message
-            header.packet_no = packet_no;
-            data[0].iov_base = reinterpret_cast<char*>(&header);
-            data[0].iov_len  = sizeof(DataPacket) - 1;
+            Datagram d = make_datagram(target, header, packet_no);
 
             // Work out what chunk of data we are sending
+            d.data   = payload + (size_t(packet_no) * packet_data_mtu);
+            d.length = packet_no + 1 < header.packet_count ? packet_data_mtu : length % packet_data_mtu;
+
+            datagrams.push_back(d);
+        }
+
+        void NUClearNetwork::add_datagram(std::vector<Datagram>& datagrams,
+                                          const sock_t& target,
+                                          const PacketQueue& queue,
+                                          const DataPacketV3& header,
+                                          uint32_t packet_no) const {
+
+            // Streamed packets keep each chunk on its own rather than in one payload
+            if (queue.streamed) {
+                Datagram d = make_datagram(target, header, packet_no);
+                d.data     = queue.chunks[packet_no].data();
+                d.length   = queue.chunks[packet_no].size();
+                datagrams.push_back(d);
+            }
+            else {
+                add_datagram(datagrams, target, header, packet_no, queue.payload.get(), queue.length);
+            }
+        }
+
+        void NUClearNetwork::add_datagrams(std::vector<Datagram>& datagrams,
+                                           const sock_t& target,
+                                           const DataPacketV3& header,
+                                           const uint8_t* payload,
+                                           const size_t& length,
+                                           const std::vector<uint8_t>* acked) const {
+
+            for (uint32_t i = 0; i < header.packet_count; ++i) {
+                if (acked == nullptr || ((*acked)[i / 8] & uint8_t(1 << (i % 8))) == 0) {
+                    add_datagram(datagrams, target, header, i, payload, length);
+                }
+            }
+        }
+
+        int NUClearNetwork::transmit_one(const Datagram& datagram) {
+
+            std::array<iovec, 2> data{};
             // const cast is fine as posix guarantees it won't be modified on a sendmsg
-            const char* start = reinterpret_cast<const char*>(payload.data()) + (packet_no * packet_data_mtu);
-            data[1].iov_base  = const_cast<char*>(start);  // NOLINT(cppcoreguidelines-pro-type-const-cast)
-            data[1].iov_len = packet_no + 1 < header.packet_count ? packet_data_mtu : payload.size() % packet_data_mtu;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            data[0].iov_base = reinterpret_cast<char*>(const_cast<uint8_t*>(datagram.header.data()));
+            data[0].iov_len  = static_cast<decltype(data[0].iov_len)>(datagram.header_length);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            data[1].iov_base = reinterpret_cast<char*>(const_cast<uint8_t*>(datagram.data));
+            data[1].iov_len  = static_cast<decltype(data[1].iov_len)>(datagram.length);
 
-            // Set our target and send (once again const cast is fine)
-            message.msg_name    = const_cast<sockaddr*>(&target.sock);  // NOLINT(cppcoreguidelines-pro-type-const-cast)
-            message.msg_namelen = target.size();
+            msghdr message{};
+            message.msg_iov     = data.data();
+            message.msg_iovlen  = 2;
+            message.msg_namelen = datagram.target->size();
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            message.msg_name = const_cast<sockaddr*>(&datagram.target->sock);
 
             // TODO(trent): if reliable, run select first to see if this socket is writeable
             // If it is not reliable just don't send the message instead of blocking
-            sendmsg(data_fd, &message, 0);
+            ++send_calls;
+            return sendmsg(data_fd, &message, 0) < 0 ? network_errno : 0;
+        }
+
+        std::vector<int> NUClearNetwork::transmit(const std::vector<Datagram>& datagrams) {
+
+            std::vector<int> errors(datagrams.size(), 0);
+            datagrams_sent += datagrams.size();
+            size_t sent = 0;
+
+#ifdef __linux__
+            // Every datagram is its header followed by its chunk of the payload
+            std::vector<std::array<iovec, 2>> data(datagrams.size());
+            for (size_t i = 0; i < datagrams.size(); ++i) {
+                // const cast is fine as posix guarantees it won't be modified on a sendmsg
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+                data[i][0].iov_base = const_cast<uint8_t*>(datagrams[i].header.data());
+                data[i][0].iov_len  = datagrams[i].header_length;
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+                data[i][1].iov_base = const_cast<uint8_t*>(datagrams[i].data);
+                data[i][1].iov_len  = datagrams[i].length;
+            }
+
+            // With generic segmentation offload, runs of chunks going to the same place can be handed to the kernel
+            // as one large buffer that it splits back up into datagrams of the segment size. Only the last chunk in a
+            // run can be short, every header in a run has to be the same version, and a run can't be larger than a
+            // single UDP datagram could be.
+            auto segment = [this](const Datagram& d) { return d.header_length + packet_data_mtu; };
+
+            // Work out which datagrams go together as a single message to the kernel
+            // Multicast is always sent a datagram at a time as the kernel won't segment it for every interface
+            std::vector<std::pair<size_t, size_t>> runs;
+            for (size_t i = 0; i < datagrams.size();) {
+                const size_t limit = !gso_enabled || is_multicast(*datagrams[i].target)
+                                         ? 1
+                                         : std::min(size_t(MAX_GSO_SEGMENTS), 65000 / segment(datagrams[i]));
+                size_t j           = i + 1;
+                while (j < datagrams.size() && j - i < limit && datagrams[j].target == datagrams[i].target
+                       && datagrams[j].header_length == datagrams[i].header_length
+                       && datagrams[j - 1].length == packet_data_mtu) {
+                    ++j;
+                }
+                runs.emplace_back(i, j - i);
+                i = j;
+            }
+
+            // Build the messages, with the segment size attached to any that hold more than one datagram
+            struct Control {
+                alignas(cmsghdr) char buffer[CMSG_SPACE(sizeof(uint16_t))];
+            };
+            std::vector<mmsghdr> messages(runs.size());
+            std::vector<Control> controls(runs.size());
+            for (size_t r = 0; r < runs.size(); ++r) {
+                const Datagram& first = datagrams[runs[r].first];
+
+                msghdr& m    = messages[r].msg_hdr;
+                m            = msghdr{};
+                m.msg_iov    = data[runs[r].first].data();
+                m.msg_iovlen = 2 * runs[r].second;
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+                m.msg_name    = const_cast<sockaddr*>(&first.target->sock);
+                m.msg_namelen = first.target->size();
+
+                if (runs[r].second > 1) {
+                    m.msg_control    = controls[r].buffer;
+                    m.msg_controllen = sizeof(controls[r].buffer);
+
+                    cmsghdr* cmsg    = CMSG_FIRSTHDR(&m);
+                    cmsg->cmsg_level = SOL_UDP;
+                    cmsg->cmsg_type  = UDP_SEGMENT;
+                    cmsg->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+
+                    const auto size = static_cast<uint16_t>(segment(first));
+                    std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+                }
+            }
+
+            // Hand the messages to the kernel in as few calls as we can
+            size_t done = 0;
+            while (done < messages.size()) {
+                const size_t count = std::min(messages.size() - done, size_t(MAX_SEND_MESSAGES));
+                ++send_calls;
+                const int result = ::sendmmsg(data_fd, &messages[done], static_cast<unsigned int>(count), 0);
+
+                if (result > 0) {
+                    done += result;
+                }
+                // Try again if we were interrupted
+                else if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                // Old kernels don't have sendmmsg, send the rest the slow way
+                else if (result < 0 && errno == ENOSYS) {
+                    break;
+                }
+                else {
+                    const int error = result < 0 ? errno : EIO;
+                    const auto& run = runs[done++];
+
+                    // If segmentation offload is why it failed stop using it and send this run the slow way
+                    if (run.second > 1) {
+                        gso_enabled = false;
+                        for (size_t i = run.first; i < run.first + run.second; ++i) {
+                            errors[i] = transmit_one(datagrams[i]);
+                        }
+                    }
+                    // Otherwise the datagram itself failed
+                    else {
+                        errors[run.first] = error;
+                    }
+                }
+            }
+
+            // Anything we didn't get to is sent one at a time
+            sent = done < runs.size() ? runs[done].first : datagrams.size();
+#endif  // __linux__
+
+            for (; sent < datagrams.size(); ++sent) {
+                errors[sent] = transmit_one(datagrams[sent]);
+            }
+
+            return errors;
         }
 
+        NUClearNetwork::TransmitStats NUClearNetwork::transmit_stats() const {
+            TransmitStats stats;
+            stats.datagrams    = datagrams_sent;
+            stats.system_calls = send_calls;
+            stats.acks               = acks_sent;
+            stats.compressed         = packets_compressed;
+            stats.incompressible     = packets_incompressible;
+            stats.compression_input  = compression_input;
+            stats.compression_output = compression_output;
+            stats.skipped            = packets_skipped;
+            return stats;
+        }
 
         void NUClearNetwork::send(const uint64_t& hash,
                                   const std::vector<uint8_t>& payload,
                                   const std::string& target,
                                   bool reliable) {
 
+            // Reliable packets may need to be resent later so we need our own copy of the data
+            if (reliable) {
+                auto data = std::make_shared<const std::vector<uint8_t>>(payload);
+                send(hash, std::shared_ptr<const uint8_t>(data, data->data()), data->size(), target, reliable);
+            }
+            // Otherwise the data is sent before we return so we can just point at it
+            else {
+                send(hash,
+                     std::shared_ptr<const uint8_t>(std::shared_ptr<const uint8_t>(), payload.data()),
+                     payload.size(),
+                     target,
+                     reliable);
+            }
+        }
+
+        void NUClearNetwork::send(const uint64_t& hash,
+                                  std::shared_ptr<const uint8_t> payload,
+                                  const size_t& length,
+                                  const std::string& target,
+                                  bool reliable,
+                                  SendCallback on_complete,
+                                  std::chrono::steady_clock::duration timeout) {
+
             // If we are not connected throw an error
-            if (targets.empty()) {
-                throw std::runtime_error("Cannot send messages as the network is not connected");
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(target_mutex);
+                if (targets.empty()) {
+                    throw std::runtime_error("Cannot send messages as the network is not connected");
+                }
+            }
+
+            // Reliable packets to a specific target go through its congestion window
+            const bool paced = reliable && !target.empty() && congestion_control == CongestionControl::AIMD;
+
+            // The header for our packet, the payload is swapped for the compressed one if it is compressed
+            size_t size = length;
+            const DataPacketV3 header =
+                queue_packet(hash, payload, size, target, reliable, paced, false, std::move(on_complete), timeout);
+
+            /* Mutex Scope */ {
+                std::lock(target_mutex, send_queue_mutex);
+                const std::lock_guard<std::mutex> target_lock(target_mutex, std::adopt_lock);
+                const std::lock_guard<std::mutex> send_lock(send_queue_mutex, std::adopt_lock);
+
+                // Data for everyone goes to the multicast group for its type if we are using them
+                const sock_t* group = target.empty() ? type_group(hash, reliable) : nullptr;
+
+                // Now send all our packets to our targets that listen to it, or as many as their window allows
+                std::vector<Datagram> datagrams;
+                const auto* send_to = name_target.find(target);
+                if (send_to != nullptr) {
+                    const auto now = std::chrono::steady_clock::now();
+                    for (const auto& t : *send_to) {
+                        if (!t->listens_to(hash)) {
+                            continue;
+                        }
+                        if (paced) {
+                            pump(t, datagrams, now);
+                        }
+                        else {
+                            const sock_t& to = group != nullptr ? *group : t->target;
+                            add_datagrams(datagrams, to, header, payload.get(), size);
+                        }
+                    }
+                }
+                transmit(datagrams);
+            }
+        }
+
+        std::vector<std::string> NUClearNetwork::send_batch(const std::vector<BatchMessage>& messages) {
+
+            // If we are not connected throw an error
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(target_mutex);
+                if (targets.empty()) {
+                    throw std::runtime_error("Cannot send messages as the network is not connected");
+                }
+            }
+
+            std::vector<std::string> errors(messages.size());
+            std::vector<DataPacketV3> headers(messages.size());
+            std::vector<std::shared_ptr<const uint8_t>> payloads(messages.size());
+            std::vector<size_t> lengths(messages.size());
+            std::vector<bool> queued(messages.size(), false);
+            std::vector<bool> paced(messages.size(), false);
+            const bool aimd = congestion_control == CongestionControl::AIMD;
+
+            // Give every message its packet id, one bad message shouldn't stop the rest
+            for (size_t i = 0; i < messages.size(); ++i) {
+                const auto& m = messages[i];
+                try {
+                    paced[i]    = m.reliable && !m.target.empty() && aimd;
+                    payloads[i] = m.payload;
+                    lengths[i]  = m.length;
+                    headers[i]  = queue_packet(m.hash,
+                                               payloads[i],
+                                               lengths[i],
+                                               m.target,
+                                               m.reliable,
+                                               paced[i],
+                                               false,
+                                               nullptr,
+                                               std::chrono::steady_clock::duration::zero());
+                    queued[i]   = true;
+                }
+                catch (const std::exception& ex) {
+                    errors[i] = ex.what();
+                }
+            }
+
+            std::lock(target_mutex, send_queue_mutex);
+            const std::lock_guard<std::mutex> target_lock(target_mutex, std::adopt_lock);
+            const std::lock_guard<std::mutex> send_lock(send_queue_mutex, std::adopt_lock);
+
+            // Build a datagram for every chunk of every message to every target, remembering which message it is for
+            std::vector<Datagram> datagrams;
+            std::vector<size_t> owners;
+            std::vector<std::shared_ptr<NetworkTarget>> windowed;
+            for (size_t i = 0; i < messages.size(); ++i) {
+                if (queued[i]) {
+                    const auto& m       = messages[i];
+                    const auto* send_to = name_target.find(m.target);
+                    const sock_t* group = m.target.empty() ? type_group(m.hash, m.reliable) : nullptr;
+                    if (send_to != nullptr) {
+                        for (const auto& t : *send_to) {
+                            if (!t->listens_to(m.hash)) {
+                                continue;
+                            }
+                            if (paced[i]) {
+                                windowed.push_back(t);
+                            }
+                            else {
+                                add_datagrams(datagrams,
+                                              group != nullptr ? *group : t->target,
+                                              headers[i],
+                                              payloads[i].get(),
+                                              lengths[i]);
+                            }
+                        }
+                    }
+                    owners.resize(datagrams.size(), i);
+                }
+            }
+
+            // Paced messages are sent as their target's window allows, they are retransmitted if sending fails
+            const auto now = std::chrono::steady_clock::now();
+            for (const auto& t : windowed) {
+                pump(t, datagrams, now);
+            }
+
+            // Send everything and report the first failure for each message
+            const std::vector<int> failures = transmit(datagrams);
+            for (size_t d = 0; d < owners.size(); ++d) {
+                if (failures[d] != 0 && errors[owners[d]].empty()) {
+                    errors[owners[d]] = std::system_category().message(failures[d]);
+                }
+            }
+
+            return errors;
+        }
+
+        NUClearNetwork::StreamId NUClearNetwork::open_stream(const uint64_t& hash,
+                                                             const size_t& length,
+                                                             const std::string& target,
+                                                             SendCallback on_complete,
+                                                             std::chrono::steady_clock::duration timeout) {
+
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(target_mutex);
+
+                // If we are not connected throw an error
+                if (targets.empty()) {
+                    throw std::runtime_error("Cannot send messages as the network is not connected");
+                }
+
+                // The writer is held back by its target's window, there isn't one when sending to everyone
+                if (target.empty()) {
+                    throw std::runtime_error("Streams can only be sent to a named target");
+                }
+                if (name_target.find(target) == nullptr) {
+                    throw std::runtime_error("There is no target named " + target);
+                }
+            }
+
+            // Streams always go through the window whatever the congestion control, it is what paces the writer
+            std::shared_ptr<const uint8_t> payload;
+            size_t size = length;
+            const DataPacketV3 header =
+                queue_packet(hash, payload, size, target, true, true, true, std::move(on_complete), timeout);
+
+            std::lock(target_mutex, send_queue_mutex);
+            const std::lock_guard<std::mutex> target_lock(target_mutex, std::adopt_lock);
+            const std::lock_guard<std::mutex> send_lock(send_queue_mutex, std::adopt_lock);
+
+            // If the target left straight away the stream is already finished, and writing to it will say so
+            StreamId stream;
+            stream.packet_id   = header.packet_id;
+            PacketQueue* queue = send_queue.find(header.packet_id);
+            if (queue != nullptr && queue->streamed) {
+                stream.sequence = queue->sequence;
+
+                // An empty stream has nothing to wait for, so it can go straight away
+                std::vector<Datagram> datagrams;
+                const auto now = std::chrono::steady_clock::now();
+                for (const auto& t : queue->targets) {
+                    auto ptr = t.target.lock();
+                    if (ptr) {
+                        pump(ptr, datagrams, now);
+                    }
+                }
+                transmit(datagrams);
+            }
+
+            return stream;
+        }
+
+        bool NUClearNetwork::write_stream(const StreamId& stream,
+                                          const uint8_t* data,
+                                          size_t length,
+                                          std::function<void()> on_ready) {
+
+            std::lock(target_mutex, send_queue_mutex);
+            const std::lock_guard<std::mutex> target_lock(target_mutex, std::adopt_lock);
+            const std::lock_guard<std::mutex> send_lock(send_queue_mutex, std::adopt_lock);
+
+            PacketQueue* queue = send_queue.find(stream.packet_id);
+            if (queue == nullptr || queue->sequence != stream.sequence || !queue->streamed) {
+                throw std::runtime_error("Cannot write to a stream that has finished");
+            }
+            if (length > queue->length - queue->written) {
+                throw std::runtime_error("Cannot write more to a stream than the length it was opened with");
+            }
+
+            // Copy the data into its chunks, a chunk is only sent once it is full so it never moves after that
+            while (length > 0) {
+                auto& chunk = queue->chunks[queue->written / packet_data_mtu];
+                if (chunk.empty()) {
+                    chunk.reserve(packet_data_mtu);
+                }
+                const size_t n = std::min(length, size_t(packet_data_mtu) - chunk.size());
+                chunk.insert(chunk.end(), data, data + n);
+                data += n;
+                length -= n;
+                queue->written += n;
+            }
+
+            // Send what the targets' windows allow, putting the stream back in line if it had run out of chunks
+            std::vector<Datagram> datagrams;
+            const auto now = std::chrono::steady_clock::now();
+            for (const auto& t : queue->targets) {
+                auto ptr = t.target.lock();
+                if (ptr) {
+                    auto& pending = ptr->congestion.pending;
+                    const std::pair<uint32_t, uint64_t> next(stream.packet_id, stream.sequence);
+                    if (std::find(pending.begin(), pending.end(), next) == pending.end()) {
+                        pending.push_back(next);
+                    }
+                    pump(ptr, datagrams, now);
+                }
+            }
+
+            // If the writer is getting too far ahead it has to wait until acks free some chunks
+            const bool room = stream_room(*queue) > 0;
+            if (!room) {
+                queue->on_ready = std::move(on_ready);
+            }
+
+            transmit(datagrams);
+            return room;
+        }
+
+        void NUClearNetwork::abort_stream(const StreamId& stream, const std::string& reason) {
+            const std::lock_guard<std::mutex> lock(send_queue_mutex);
+
+            PacketQueue* queue = send_queue.find(stream.packet_id);
+            if (queue == nullptr || queue->sequence != stream.sequence || !queue->streamed) {
+                return;
+            }
+
+            // Whatever was still in flight no longer counts against the window
+            for (const auto& t : queue->targets) {
+                auto ptr = t.target.lock();
+                if (ptr) {
+                    ptr->congestion.in_flight -= std::min(ptr->congestion.in_flight, count_bits(t.sent));
+                }
+            }
+            complete(*queue, reason);
+            send_queue.erase(stream.packet_id);
+        }
+
+        bool NUClearNetwork::compress(std::shared_ptr<const uint8_t>& payload, size_t& length) {
+
+            // The compressed data starts with the length it decompresses to
+            const uint64_t original = length;
+            const size_t prefix     = sizeof(original);
+            if (length <= prefix + 1) {
+                return false;
+            }
+
+            // It is only worth sending compressed if it is smaller, so give up as soon as it won't be
+            std::unique_ptr<uint8_t[]> buffer(new uint8_t[length - 1]);  // NOLINT(modernize-avoid-c-arrays)
+            const size_t compressed =
+                util::serialise::lz4_compress(payload.get(), length, buffer.get() + prefix, length - 1 - prefix);
+            if (compressed == 0) {
+                ++packets_incompressible;
+                return false;
+            }
+            std::memcpy(buffer.get(), &original, prefix);
+
+            // Copy it into a buffer of the right size, as reliable packets are held until they are acknowledged
+            auto data = std::make_shared<const std::vector<uint8_t>>(buffer.get(), buffer.get() + prefix + compressed);
+            payload   = std::shared_ptr<const uint8_t>(data, data->data());
+            length    = data->size();
+
+            ++packets_compressed;
+            compression_input += original;
+            compression_output += length;
+            return true;
+        }
+
+        bool NUClearNetwork::decompress(const Compression& compression, std::vector<uint8_t>& payload) const {
+            switch (compression) {
+                case COMPRESSION_NONE: return true;
+                case COMPRESSION_LZ4: {
+                    uint64_t original   = 0;
+                    const size_t prefix = sizeof(original);
+                    if (payload.size() < prefix) {
+                        return false;
+                    }
+                    std::memcpy(&original, payload.data(), prefix);
+
+                    // LZ4 can't make data more than 255 times smaller, so anything claiming more is corrupt and we
+                    // don't want to allocate it, nor anything larger than the largest packet we accept
+                    const uint64_t limit = max_message_size;
+                    if (original / 255 > payload.size() || (limit > 0 && original > limit)) {
+                        return false;
+                    }
+
+                    std::vector<uint8_t> out(static_cast<size_t>(original));
+                    if (!util::serialise::lz4_decompress(payload.data() + prefix,
+                                                         payload.size() - prefix,
+                                                         out.data(),
+                                                         out.size())) {
+                        return false;
+                    }
+                    payload = std::move(out);
+                    return true;
+                }
+                // A compression we don't understand, which we never told them we do
+                default: return false;
+            }
+        }
+
+        DataPacketV3 NUClearNetwork::queue_packet(const uint64_t& hash,
+                                                  std::shared_ptr<const uint8_t>& payload,
+                                                  size_t& length,
+                                                  const std::string& target,
+                                                  bool reliable,
+                                                  bool paced,
+                                                  bool streamed,
+                                                  SendCallback on_complete,
+                                                  std::chrono::steady_clock::duration timeout) {
+
+            // Only reliable packets are acknowledged, so nobody would ever hear back about anything else
+            if (on_complete && !reliable) {
+                throw std::runtime_error("Only reliable packets can report when they are delivered");
+            }
+
+            // We can only use version 3 if everyone we are sending to has announced it, and the same for compression
+            // Peers that don't listen to this type aren't sent it, except for streams which were asked for by name
+            Version version  = V3;
+            bool lz4         = true;
+            size_t receivers = 0;
+            /* Mutex Scope */ {
+                const std::lock_guard<std::mutex> lock(target_mutex);
+                auto check_version = [&](const std::string& name,
+                                         const std::vector<std::shared_ptr<NetworkTarget>>& to) {
+                    for (const auto& t : to) {
+                        if (!name.empty() && !streamed && !t->listens_to(hash)) {
+                            // Unreliable data for everyone is multicast, so it still reaches them
+                            if (reliable || !target.empty()) {
+                                ++packets_skipped;
+                            }
+                        }
+                        else if (!name.empty()) {
+                            ++receivers;
+                            version = t->version < V3 ? V2 : version;
+                            lz4     = lz4 && (t->features & FEATURE_LZ4) != 0;
+                        }
+                    }
+                };
+                if (target.empty()) {
+                    name_target.for_each(check_version);
+                }
+                else if (const auto* to = name_target.find(target)) {
+                    check_version(target, *to);
+                }
+            }
+
+            // Large packets are compressed if it is worth it, streams are never compressed as their data isn't here yet
+            const size_t threshold  = compression_threshold;
+            Compression compression = COMPRESSION_NONE;
+            if (!streamed && threshold > 0 && length >= threshold && version == V3 && lz4 && receivers > 0
+                && (!compression_filter || compression_filter(hash)) && compress(payload, length)) {
+                compression = COMPRESSION_LZ4;
+            }
+
+            // The packet count needs to fit in the header
+            const uint64_t packet_count = length / packet_data_mtu + 1;
+            if (packet_count > std::numeric_limits<uint32_t>::max()) {
+                throw std::runtime_error("Cannot send a message this large, it needs too many packets");
+            }
+            if (version == V2 && packet_count > std::numeric_limits<uint16_t>::max()) {
+                throw std::runtime_error(
+                    "Cannot send a message this large to a target that only understands version 2 of the protocol");
             }
 
             // The header for our packet
-            DataPacket header;
+            DataPacketV3 header;
+            header.version = version;
 
             /* Mutex Scope */ {
                 const std::lock_guard<std::mutex> lock(send_queue_mutex);
+
+                // If every packet id is waiting for acknowledgement there is nothing we can use
+                if (send_queue.size() >= SendQueue::CAPACITY) {
+                    throw std::runtime_error("Too many reliable messages are waiting to be acknowledged");
+                }
+
                 // For the packet id we ensure that it's not currently used for retransmission
-                while (send_queue.count(++packet_id_source) > 0) {
+                while (!send_queue.available(++packet_id_source)) {
                 }
-                header.packet_id = packet_id_source;
+                header.packet_id = version == V3 ? packet_id_source : uint16_t(packet_id_source);
             }
 
             header.packet_no    = 0;
-            header.packet_count = uint16_t((payload.size() / packet_data_mtu) + 1);
+            header.packet_count = uint32_t(packet_count);
             header.reliable     = reliable;
+            header.compression  = compression;
             header.hash         = hash;
+            header.length       = length;
 
             // If this was a reliable packet we need to cache it in case it needs to be resent
             if (reliable) {
@@ -1074,46 +3106,77 @@ namespace extension {
                 const std::lock_guard<std::mutex> lock_target(target_mutex, std::adopt_lock);
                 const std::lock_guard<std::mutex> lock_send(send_queue_mutex, std::adopt_lock);
 
-                auto& queue = send_queue[header.packet_id];
+                auto& queue = send_queue.insert(header.packet_id);
 
                 // Store the header, but update it's type to be a retransmission so it can be ignored if
                 // overtransmitted
                 queue.header      = header;
                 queue.header.type = DATA_RETRANSMISSION;
-                // TODO(trent): there might be some better memory management that can happen here
-                queue.payload = payload;
+                queue.payload     = payload;
+                queue.length      = length;
+                queue.first_send  = std::chrono::steady_clock::now();
+                queue.on_complete = std::move(on_complete);
+                queue.paced       = paced;
+                queue.streamed    = streamed;
                 const std::vector<uint8_t> acks((header.packet_count / 8) + 1, 0);
 
-                // Find interested parties or if multicast it's everyone we are connected to
-                auto range = target.empty() ? std::make_pair(name_target.begin(), name_target.end())
-                                            : name_target.equal_range(target);
-                for (auto it = range.first; it != range.second; ++it) {
+                // Streamed chunks are filled in as they are written
+                if (streamed) {
+                    queue.chunks.resize(header.packet_count);
+                }
+
+                // If we are only willing to wait so long make sure we are around to give up
+                if (timeout > std::chrono::steady_clock::duration::zero()) {
+                    queue.deadline = queue.first_send + timeout;
+                }
+
+                // The soonest we need to look at this packet again
+                auto check = queue.deadline;
+
+                // Find interested parties or if multicast it's everyone we are connected to that listens to it
+                bool skipped     = false;
+                auto add_targets = [&](const std::string& name,
+                                       const std::vector<std::shared_ptr<NetworkTarget>>& to) {
                     // If this target is an announce target ignore it
-                    if (!it->first.empty()) {
-                        // Add this guy to the queue
-                        queue.targets.emplace_back(it->second, acks);
-
-                        // The next time we should check for a timeout
-                        auto next_timeout = std::chrono::steady_clock::now() + it->second->round_trip_time;
-                        if (next_timeout < next_event) {
-                            next_event = next_timeout;
-                            next_event_callback(next_event);
+                    if (!name.empty()) {
+                        for (const auto& t : to) {
+                            if (!streamed && !t->listens_to(hash)) {
+                                skipped = true;
+                                continue;
+                            }
+
+                            // Add this guy to the queue
+                            queue.targets.emplace_back(t, name, acks);
+
+                            // Paced chunks wait their turn in the target's window
+                            if (paced) {
+                                queue.targets.back().sent = acks;
+                                t->congestion.pending.emplace_back(uint32_t(header.packet_id), queue.sequence);
+                            }
+
+                            // The next time we should check for a timeout
+                            check = std::min(check, queue.first_send + t->round_trip_time);
                         }
                     }
+                };
+                if (target.empty()) {
+                    name_target.for_each(add_targets);
+                }
+                else if (const auto* to = name_target.find(target)) {
+                    add_targets(target, *to);
                 }
-            }
-
-            /* Mutex Scope */ {
-                const std::lock_guard<std::mutex> lock(target_mutex);
 
-                // Now send all our packets to our targets
-                auto send_to = name_target.equal_range(target);
-                for (uint16_t i = 0; i < header.packet_count; ++i) {
-                    for (auto s = send_to.first; s != send_to.second; ++s) {
-                        send_packet(s->second->target, header, i, payload, reliable);
-                    }
+                // If there is nobody to send to then we are already done
+                if (queue.targets.empty()) {
+                    complete(queue, target.empty() || skipped ? "" : "There is no target named " + target);
+                    send_queue.erase(header.packet_id);
+                }
+                else {
+                    schedule_retransmit(queue, check);
                 }
             }
+
+            return header;
         }
 
     }  // namespace network
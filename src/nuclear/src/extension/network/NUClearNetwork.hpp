@@ -27,16 +27,22 @@
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <limits>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <queue>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "../../util/OpenHashMap.hpp"
+#include "../../util/network/InterestFilter.hpp"
+#include "../../util/network/PacketIdWindow.hpp"
 #include "../../util/network/sock_t.hpp"
 #include "../../util/platform.hpp"
 #include "wire_protocol.hpp"
@@ -56,11 +62,7 @@ namespace extension {
                     std::string name,
                     const sock_t& target,
                     const std::chrono::steady_clock::time_point& last_update = std::chrono::steady_clock::now())
-                    : name(std::move(name)), target(target), last_update(last_update) {
-
-                    // Set our recent packets to an invalid value
-                    recent_packets.fill(-1);
-                }
+                    : name(std::move(name)), target(target), last_update(last_update) {}
 
                 /// The name of the remote target
                 std::string name;
@@ -68,22 +70,115 @@ namespace extension {
                 sock_t target{};
                 /// When we last received data from the remote target
                 std::chrono::steady_clock::time_point last_update;
-                /// A list of the last n packet groups to be received
-                std::array<int, std::numeric_limits<uint8_t>::max()> recent_packets{};
-                /// An index for the recent_packets (circular buffer)
-                std::atomic<uint8_t> recent_packets_index{0};
-                /// Mutex to protect the fragmented packet storage
+                /// The newest protocol version the remote target has announced
+                std::atomic<uint8_t> version{V2};
+                /// The optional features the remote target has announced it supports, a bitset of Feature
+                std::atomic<uint8_t> features{0};
+                /// How many multicast groups the remote target spreads untargeted data over by type
+                std::atomic<uint8_t> type_groups{0};
+                /// The types the remote target listens to if it has FEATURE_INTEREST, guarded by the target mutex
+                util::network::InterestFilter<INTEREST_FILTER_SIZE> interest;
+                /// The version of the remote target's interest filter that we have, guarded by the target mutex
+                uint16_t interest_version{0};
+
+                /**
+                 * Check if the remote target might listen to a type of data. Targets that haven't told us which types
+                 * they listen to might listen to anything.
+                 * The target mutex must be held.
+                 *
+                 * @param hash The identifying hash for the data
+                 *
+                 * @return false if the remote target definitely doesn't listen to this type
+                 */
+                bool listens_to(const uint64_t& hash) const {
+                    return (features & FEATURE_INTEREST) == 0 || interest.contains(hash);
+                }
+                /// The version 2 packet ids of the recent packets we have received in full, guarded by the assemblers
+                /// mutex
+                util::network::PacketIdWindow<uint16_t, 1024> recent_packets;
+                /// The version 3 packet ids of the recent packets we have received in full, guarded by the assemblers
+                /// mutex
+                util::network::PacketIdWindow<uint32_t, 1024> recent_packets_v3;
+
+                /**
+                 * Check if a packet was recently received in full.
+                 * The assemblers mutex must be held.
+                 *
+                 * @param version   The protocol version the packet was sent with
+                 * @param packet_id The id of the packet, all 32 bits of it for version 3
+                 *
+                 * @return true if the packet has already been received
+                 */
+                bool recently_received(const uint8_t& version, const uint32_t& packet_id) const {
+                    return version == V3 ? recent_packets_v3.contains(packet_id)
+                                         : recent_packets.contains(uint16_t(packet_id));
+                }
+
+                /**
+                 * Remember that a packet was received in full, so any copies of it that arrive later are dropped.
+                 * The assemblers mutex must be held.
+                 *
+                 * @param version   The protocol version the packet was sent with
+                 * @param packet_id The id of the packet, all 32 bits of it for version 3
+                 */
+                void mark_received(const uint8_t& version, const uint32_t& packet_id) {
+                    if (version == V3) {
+                        recent_packets_v3.insert(packet_id);
+                    }
+                    else {
+                        recent_packets.insert(uint16_t(packet_id));
+                    }
+                }
+
+                /// A fragmented packet that is being put back together
+                struct Assembler {
+                    /// When we last received a chunk of this packet
+                    std::chrono::steady_clock::time_point last_chunk;
+                    /// The protocol version the packet is being sent with
+                    uint8_t version{V2};
+                    /// How many chunks the packet was split into
+                    uint32_t packet_count{0};
+                    /// How many distinct chunks we have received
+                    uint32_t received_count{0};
+                    /// The total size of the packet if the sender told us, otherwise 0
+                    uint64_t length{0};
+                    /// The size of every chunk except the last, learnt from the first one that isn't the last
+                    size_t stride{0};
+                    /// The size of the last chunk once it has been received
+                    size_t last_length{0};
+                    /// The packet data, each chunk is written straight to its final offset once the stride is known
+                    std::vector<uint8_t> data;
+                    /// The last chunk if it arrived before we knew where to put it
+                    std::vector<uint8_t> tail;
+                    /// One bit for each chunk that has been received, laid out the same as an ACK packet
+                    std::vector<uint8_t> received;
+                    /// One past the highest chunk received, a chunk beyond this means the ones between were lost
+                    uint32_t next_chunk{0};
+                    /// How many chunks have arrived since we last sent an ack
+                    uint32_t unacked{0};
+                    /// The first byte of the received bitset with a chunk missing, everything before it has arrived
+                    size_t ack_base{0};
+                    /// When the ack for the chunks that have arrived has to be sent by, max if none is waiting
+                    std::chrono::steady_clock::time_point ack_due{std::chrono::steady_clock::time_point::max()};
+                    /// If the packet is handed to the stream callback a piece at a time rather than assembled
+                    bool streamed{false};
+                    /// For streamed packets, how many chunks from the start have been handed to the stream callback
+                    uint32_t delivered{0};
+                    /// For streamed packets, the chunks that arrived before the ones ahead of them
+                    std::map<uint32_t, std::vector<uint8_t>> waiting;
+                };
+
+                /// Mutex to protect the fragmented packet storage and the recent packets
                 std::mutex assemblers_mutex;
                 /// Storage for fragmented packets while we build them
-                std::map<uint16_t,
-                         std::pair<std::chrono::steady_clock::time_point, std::map<uint16_t, std::vector<uint8_t>>>>
-                    assemblers;
+                std::map<uint32_t, Assembler> assemblers;
 
                 /// Struct storing the kalman filter for round trip time
+                /// It starts very unsure of its one second guess so the first few measurements quickly replace it
                 struct RoundTripKF {
                     float process_noise     = 1e-6f;
                     float measurement_noise = 1e-1f;
-                    float variance          = 1.0f;
+                    float variance          = 1e3f;
                     float mean              = 1.0f;
                 };
                 /// A little kalman filter for estimating round trip time
@@ -114,6 +209,43 @@ namespace extension {
                     round_trip_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
                         std::chrono::duration<float>(X));
                 }
+
+                /// How long after sending paced chunks to this target we should have an ack for them, allowing for
+                /// the ack being held back while the target waits for more chunks
+                std::chrono::steady_clock::duration ack_timeout() const {
+                    return round_trip_time + std::chrono::milliseconds(int(ACK_DELAY));
+                }
+
+                /// Congestion control state for reliable data sent to this target, guarded by the send queue mutex
+                struct Congestion {
+                    /// How many datagrams we allow to be waiting for acknowledgement at once
+                    double window{16};
+                    /// Above this window size it grows linearly rather than doubling every round trip
+                    double threshold{std::numeric_limits<double>::max()};
+                    /// How many datagrams are waiting for acknowledgement
+                    size_t in_flight{0};
+                    /// How many datagrams we can send right now without going faster than our pacing rate
+                    double tokens{16};
+                    /// When tokens were last added
+                    std::chrono::steady_clock::time_point last_refill;
+                    /// The round trip time measured from the most recent ack
+                    std::chrono::steady_clock::duration latest_round_trip{std::chrono::seconds(1)};
+                    /// When the window was last reduced, it is only reduced once per round trip
+                    std::chrono::steady_clock::time_point last_decrease;
+                    /// The packets (packet id and sequence) that have chunks waiting for room in the window
+                    std::deque<std::pair<uint32_t, uint64_t>> pending;
+                };
+                /// Our congestion control state for sending to this target
+                Congestion congestion{};
+            };
+
+            /// How reliable data is sent to each target
+            enum class CongestionControl {
+                /// Send every chunk straight away and resend all unacknowledged chunks each round trip
+                NONE,
+                /// Limit the unacknowledged chunks with an additive increase, multiplicative decrease window and
+                /// pace them out over the round trip
+                AIMD
             };
 
             NUClearNetwork() = default;
@@ -136,6 +268,171 @@ namespace extension {
                       const std::string& target,
                       bool reliable);
 
+            /// The outcome of a reliable send
+            struct SendResult {
+                /// If every target acknowledged the packet
+                bool delivered{false};
+                /// Why the packet was not delivered
+                std::string error;
+                /// How long each target took to acknowledge the packet after it was first sent, by target name
+                std::vector<std::pair<std::string, std::chrono::steady_clock::duration>> latency;
+            };
+
+            /// Called once a reliable send has been acknowledged by every target, or can no longer be delivered
+            using SendCallback = std::function<void(const SendResult&)>;
+
+            /**
+             * Send data using the NUClear network without copying it.
+             *
+             * The payload is referenced rather than copied, for reliable sends it is held until every target has
+             * acknowledged it (or left the network) and then released.
+             * The bytes must not be modified while they are held.
+             *
+             * For reliable sends a callback can be given to find out when the packet has been delivered. It is called
+             * from whichever thread is using the network at the time and must not call back into the network.
+             *
+             * @param hash        The identifying hash for the data
+             * @param payload     The bytes that are to be sent, the deleter of this pointer releases them
+             * @param length      The number of bytes in the payload
+             * @param target      Who we are sending to (blank means everyone)
+             * @param reliable    If the delivery of the data should be ensured
+             * @param on_complete Called when every target has acknowledged the packet, or it fails to be delivered
+             * @param timeout     How long to wait for every target to acknowledge the packet, zero waits forever
+             */
+            void send(const uint64_t& hash,
+                      std::shared_ptr<const uint8_t> payload,
+                      const size_t& length,
+                      const std::string& target,
+                      bool reliable,
+                      SendCallback on_complete                     = nullptr,
+                      std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::zero());
+
+            /// Counters for the pool of buffers that datagrams are received into
+            struct BufferPoolStats {
+                /// How many times a buffer was reused from the pool
+                uint64_t hits{0};
+                /// How many times the pool was empty so a new buffer was allocated
+                uint64_t misses{0};
+                /// How many buffers are waiting in the pool to be reused
+                size_t available{0};
+            };
+
+            /**
+             * Get the counters for the pool of buffers that datagrams are received into.
+             *
+             * @return the current counters
+             */
+            BufferPoolStats buffer_pool_stats();
+
+            /// Counters for the datagrams sent on the data socket
+            struct TransmitStats {
+                /// How many datagrams have been sent
+                uint64_t datagrams{0};
+                /// How many system calls were made to send them
+                uint64_t system_calls{0};
+                /// How many acks have been sent for chunks of reliable packets
+                uint64_t acks{0};
+                /// How many packets were sent compressed
+                uint64_t compressed{0};
+                /// How many packets were compressed but sent as they were, as compressing didn't make them smaller
+                uint64_t incompressible{0};
+                /// How many bytes the packets that were sent compressed had before they were compressed
+                uint64_t compression_input{0};
+                /// How many bytes the packets that were sent compressed had after they were compressed
+                uint64_t compression_output{0};
+                /// How many times a peer was left out of a packet as it doesn't listen to the packet's type
+                uint64_t skipped{0};
+            };
+
+            /**
+             * Get the counters for the datagrams sent on the data socket.
+             *
+             * @return the current counters
+             */
+            TransmitStats transmit_stats() const;
+
+            /// A single message to send as part of a batch
+            struct BatchMessage {
+                /// The identifying hash for the data
+                uint64_t hash{0};
+                /// The data to send, for reliable messages it is held until every target has acknowledged it
+                std::shared_ptr<const uint8_t> payload;
+                /// The number of bytes in the payload
+                size_t length{0};
+                /// Who we are sending to (blank means everyone)
+                std::string target;
+                /// If the delivery of the data should be ensured
+                bool reliable{false};
+            };
+
+            /**
+             * Send many messages using the NUClear network, transmitting the datagrams for every message and target
+             * together. Where the platform supports it they are handed to the kernel with sendmmsg so the whole batch
+             * takes only a few system calls.
+             *
+             * @param messages The messages to send
+             *
+             * @return A description of the error for each message, or an empty string if it was sent
+             */
+            std::vector<std::string> send_batch(const std::vector<BatchMessage>& messages);
+
+            /// Identifies a message that is being written a piece at a time
+            struct StreamId {
+                /// The packet id the message is sent with
+                uint32_t packet_id{0};
+                /// The sequence number of the message in the send queue, so a reused packet id isn't mistaken for it
+                uint64_t sequence{0};
+            };
+
+            /**
+             * Start sending a reliable message whose payload is written a piece at a time with write_stream, so it
+             * never has to be held in memory all at once.
+             *
+             * The length of the message has to be known up front as every datagram carries how many chunks there are.
+             * Chunks are sent through each target's congestion window as soon as they have been written, and are
+             * freed once every target has acknowledged them.
+             *
+             * @param hash        The identifying hash for the data
+             * @param length      The number of bytes that will be written to the stream
+             * @param target      Who we are sending to, streams always have a named target
+             * @param on_complete Called when every target has acknowledged the message, or it fails to be delivered
+             * @param timeout     How long to wait for every target to acknowledge the message, zero waits forever
+             *
+             * @return The id to write the payload to
+             */
+            StreamId open_stream(
+                const uint64_t& hash,
+                const size_t& length,
+                const std::string& target,
+                SendCallback on_complete                     = nullptr,
+                std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::zero());
+
+            /**
+             * Write the next piece of a message opened with open_stream.
+             * The bytes are copied, and the message is sent once all of its length has been written.
+             *
+             * @param stream   The stream to write to
+             * @param data     The bytes to write
+             * @param length   The number of bytes to write
+             * @param on_ready If there is no room for more, called once when there is or when the stream finishes.
+             *                 It is called from whichever thread is using the network and must not call back into it
+             *
+             * @return true if more can be written straight away, false if the writer should wait for on_ready
+             */
+            bool write_stream(const StreamId& stream,
+                              const uint8_t* data,
+                              size_t length,
+                              std::function<void()> on_ready = nullptr);
+
+            /**
+             * Give up on sending a message opened with open_stream, its on_complete is called with the reason.
+             * Nothing happens if the stream has already finished.
+             *
+             * @param stream The stream to give up on
+             * @param reason Why the message won't be sent
+             */
+            void abort_stream(const StreamId& stream, const std::string& reason);
+
             /**
              * Set the callback to use when a data packet is completed.
              *
@@ -144,6 +441,123 @@ namespace extension {
             void set_packet_callback(
                 std::function<void(const NetworkTarget&, const uint64_t&, const bool&, std::vector<uint8_t>&&)> f);
 
+            /**
+             * Set the filter used to decide which types of data packet we want before they are assembled.
+             * Packets that are filtered out are still acknowledged so the sender stops sending them, but they are never
+             * copied or passed to the packet callback.
+             *
+             * @param f The filter function, returning true if we want packets with this hash
+             */
+            void set_packet_filter(std::function<bool(const uint64_t&)> f);
+
+            /**
+             * Set the filter used to decide which types of data packet are handed to the stream callback a piece at a
+             * time as their chunks arrive in order, rather than to the packet callback once they are complete.
+             * Only reliable packets of more than one chunk can be streamed, the rest always go to the packet callback.
+             *
+             * @param f The filter function, returning true if packets with this hash should be streamed
+             */
+            void set_stream_filter(std::function<bool(const uint64_t&)> f);
+
+            /**
+             * Set the function that says how many more datagrams can be read before whoever the packet callback hands
+             * packets to has to catch up. A datagram completes at most one packet, so this bounds how many packets can
+             * be waiting for them. When it says 0 nothing more is read until a later call to process.
+             * If it is not set there is no limit.
+             *
+             * @param f The function returning how many more datagrams can be read
+             */
+            void set_receive_limit(std::function<size_t()> f);
+
+            /// Called with each piece of a streamed packet in order, the packet id tells the pieces of packets apart
+            using StreamCallback = std::function<void(const NetworkTarget& /*target*/,
+                                                      const uint64_t& /*hash*/,
+                                                      const uint32_t& /*packet_id*/,
+                                                      std::vector<uint8_t>&& /*piece*/,
+                                                      const bool& /*last*/)>;
+
+            /**
+             * Set the callback to use when the next piece of a streamed packet arrives.
+             *
+             * @param f The callback function
+             */
+            void set_stream_callback(StreamCallback f);
+
+            /**
+             * Set how large a data packet has to be before it is compressed with LZ4. A packet is only compressed when
+             * everyone it is sent to has announced they can decompress it, and only sent compressed if that made it
+             * smaller. Streams are never compressed.
+             * This applies to packets sent after it is changed.
+             *
+             * @param threshold The fewest bytes a packet can have and be compressed, 0 never compresses anything
+             */
+            void set_compression_threshold(size_t threshold);
+
+            /**
+             * Set the largest data packet we accept, so a corrupt or malicious chunk can't make us allocate an
+             * unbounded amount of memory for it. Chunks of larger packets are dropped without being acknowledged, as
+             * are compressed packets that would be larger once decompressed.
+             *
+             * @param size The most bytes a data packet can have, 0 accepts any size
+             */
+            void set_max_message_size(size_t size);
+
+            /**
+             * Set the filter used to decide which types of data packet can be compressed, so data that is already
+             * compressed (such as images) isn't compressed again for nothing. If it is not set every type can be.
+             *
+             * @param f The filter function, returning true if packets with this hash can be compressed
+             */
+            void set_compression_filter(std::function<bool(const uint64_t&)> f);
+
+            /**
+             * Set how many multicast groups untargeted data is spread over, chosen by the hash of its type, so that
+             * nodes only receive the types they listen to. The groups count up from the announce group, and data is
+             * only sent to them when everyone on the network has announced the same number of groups. Reliable data is
+             * only sent to them when everyone also tells us which types they listen to, as only those who listen to a
+             * type acknowledge it.
+             * This takes effect on the next reset, and only when the announce address is a multicast group.
+             *
+             * @param count The number of groups to use, 0 sends everything to the announce group
+             */
+            void set_type_groups(uint8_t count);
+
+            /**
+             * Say whether we are listening to a type of data, so if untargeted data is spread over multicast groups we
+             * join the group it is sent to, and if we advertise our interest our peers are told straight away.
+             *
+             * @param hash      The identifying hash for the data
+             * @param listening If we want data of this type
+             */
+            void listen(const uint64_t& hash, bool listening);
+
+            /**
+             * Say whether we are listening to every type of data, which joins every multicast group data is spread
+             * over.
+             *
+             * @param listening If we want data of every type
+             */
+            void listen_all(bool listening);
+
+            /**
+             * Set whether we tell our peers which types we listen to (as given to listen and listen_all) in our
+             * announce packets. Peers that know skip us when sending types we don't listen to, so we don't have to
+             * receive or acknowledge them, but it means we must only ever want the types we have said we listen to.
+             * Peers are told again whenever the types we listen to change, without waiting for the next announce.
+             *
+             * @param advertise true to tell our peers which types we listen to, false to be sent every type
+             */
+            void set_advertise_interest(bool advertise);
+
+            /**
+             * Set how reliable data sent to a specific target is paced. Packets to everyone are always sent at once
+             * as they go out to the whole network in a single transmission.
+             * This applies to packets sent after it is changed.
+             *
+             * @param mode The congestion control to use
+             */
+            void set_congestion_control(CongestionControl mode);
+
             /**
              * Set the callback to use when a node joins the network.
              *
@@ -208,21 +622,88 @@ namespace extension {
             std::vector<fd_t> listen_fds();
 
         private:
+            /// A pool of datagram sized buffers, so receiving doesn't need a fresh allocation for every datagram
+            class BufferPool {
+            public:
+                /**
+                 * Set how large a datagram the buffers need to hold, dropping any pooled buffers that are too small.
+                 *
+                 * @param size The size of the largest datagram we can receive
+                 */
+                void resize(size_t size);
+
+                /// @return how large a datagram the buffers hold
+                size_t size() const;
+
+                /**
+                 * Take a buffer out of the pool, allocating a new one if the pool is empty.
+                 *
+                 * @return a buffer large enough to hold any datagram
+                 */
+                std::vector<uint8_t> acquire();
+
+                /**
+                 * Give a buffer back to the pool so it can be reused.
+                 * Buffers that are too small (such as ones that have been moved from) or that don't fit are freed.
+                 *
+                 * @param buffer The buffer to give back
+                 */
+                void release(std::vector<uint8_t>&& buffer);
+
+                /// @return the counters for this pool
+                BufferPoolStats stats();
+
+            private:
+                /// The most buffers we keep around when they aren't being used
+                static constexpr size_t MAX_POOLED = 256;
+
+                /// Protects the pool as packets can be processed from more than one thread
+                std::mutex mutex;
+                /// How large a datagram the buffers hold
+                std::atomic<size_t> buffer_size{1500};
+                /// The buffers waiting to be reused
+                std::vector<std::vector<uint8_t>> buffers;
+                /// How often the pool did and didn't have a buffer for us
+                uint64_t hits{0};
+                uint64_t misses{0};
+            };
+
             struct PacketQueue {
 
                 struct PacketTarget {
 
                     /// Constructor a new PacketTarget
-                    PacketTarget(std::weak_ptr<NetworkTarget> target, std::vector<uint8_t> acked);
+                    PacketTarget(std::weak_ptr<NetworkTarget> target, std::string name, std::vector<uint8_t> acked);
 
                     /// The target we are sending this packet to
                     std::weak_ptr<NetworkTarget> target;
 
+                    /// The name of the target, kept so we can still report on them if they leave
+                    std::string name;
+
                     /// The bitset of the packets that have been acked
                     std::vector<uint8_t> acked;
 
+                    /// How many bits are set in acked
+                    uint32_t acked_count{0};
+
+                    /// Every packet before this one has been marked in acked
+                    uint32_t acked_below{0};
+
                     /// When we last sent data to this client
                     std::chrono::steady_clock::time_point last_send;
+
+                    /// For paced packets, the bitset of the chunks that have been sent and are waiting on an ack
+                    std::vector<uint8_t> sent;
+
+                    /// For paced packets, when an ack last told us that chunks in flight had arrived
+                    std::chrono::steady_clock::time_point last_ack;
+
+                    /// For paced packets, the first chunk that might still need sending
+                    uint32_t next_chunk{0};
+
+                    /// For paced packets, if chunks have been lost and are now being resent
+                    bool resending{false};
                 };
 
                 /// Default constructor for the PacketQueue
@@ -231,13 +712,155 @@ namespace extension {
                 /// The remote targets that want this packet
                 std::list<PacketTarget> targets;
 
-                /// The header of the packet to send
-                DataPacket header;
+                /// The header of the packet to send, it is written out as version 2 if that is its version
+                DataPacketV3 header;
 
                 /// The data to send
-                std::vector<uint8_t> payload;
+                std::shared_ptr<const uint8_t> payload;
+
+                /// The number of bytes in the payload
+                size_t length{0};
+
+                /// When the packet was first sent
+                std::chrono::steady_clock::time_point first_send;
+
+                /// When to give up waiting for acknowledgements
+                std::chrono::steady_clock::time_point deadline{std::chrono::steady_clock::time_point::max()};
+
+                /// Called when the packet is delivered to every target, or can't be
+                SendCallback on_complete;
+
+                /// How long each target that has acknowledged the packet took
+                std::vector<std::pair<std::string, std::chrono::steady_clock::duration>> latency;
+
+                /// Unique for every packet added to the send queue, so events for a reused packet id can be told apart
+                uint64_t sequence{0};
+
+                /// When the retransmit scheduler will next look at this packet
+                std::chrono::steady_clock::time_point next_check;
+
+                /// If the chunks of this packet are sent through each target's congestion window
+                bool paced{false};
+
+                /// If the payload is being written a piece at a time, in which case it is held in chunks
+                bool streamed{false};
+
+                /// For streamed packets, the data for each chunk, freed once every target has acknowledged it
+                std::vector<std::vector<uint8_t>> chunks;
+
+                /// For streamed packets, how many bytes have been written so far
+                size_t written{0};
+
+                /// For streamed packets, every chunk before this one has been acknowledged and freed
+                uint32_t released{0};
+
+                /// For streamed packets, called once the writer has room to write more
+                std::function<void()> on_ready;
+            };
+
+            /// A time when a packet in the send queue needs to be looked at for retransmission or giving up
+            struct RetransmitEvent {
+                /// When the packet needs to be looked at
+                std::chrono::steady_clock::time_point due;
+                /// The packet to look at
+                uint32_t packet_id{0};
+                /// The sequence number of the packet when this event was made
+                uint64_t sequence{0};
+
+                bool operator>(const RetransmitEvent& other) const {
+                    return due > other.due;
+                }
+            };
+
+            /**
+             * The reliable packets waiting to be acknowledged.
+             * The packets are kept together in one array, and found through a table indexed directly by the lower 16
+             * bits of their packet id, so no two waiting packets can share those bits.
+             * Erasing moves the last packet into the hole, so iterators and references are invalidated by any change.
+             */
+            class SendQueue {
+            public:
+                using iterator = std::vector<PacketQueue>::iterator;
+
+                /// The most packets that can be waiting at once, one packet id is needed to mark empty slots
+                static constexpr size_t CAPACITY = std::numeric_limits<uint16_t>::max();
+
+                /**
+                 * Find the packet with the given id.
+                 *
+                 * @param packet_id The id of the packet
+                 *
+                 * @return the packet or nullptr if there isn't one with this id
+                 */
+                PacketQueue* find(uint32_t packet_id);
+
+                /**
+                 * Check if a packet id can be given to a new packet.
+                 *
+                 * @param packet_id The id of the packet
+                 *
+                 * @return true if no waiting packet shares the lower 16 bits of this id
+                 */
+                bool available(uint32_t packet_id) const;
+
+                /**
+                 * Add a new packet with the given id, which must not already be in the queue.
+                 *
+                 * @param packet_id The id of the packet
+                 *
+                 * @return the new packet
+                 */
+                PacketQueue& insert(uint32_t packet_id);
+
+                /**
+                 * Remove the packet with the given id if there is one.
+                 *
+                 * @param packet_id The id of the packet
+                 */
+                void erase(uint32_t packet_id);
+
+                /**
+                 * Remove the packet at the given position.
+                 *
+                 * @param it The packet to remove
+                 *
+                 * @return the position of the next packet to look at, which is where the last packet was moved to
+                 */
+                iterator erase(iterator it);
+
+                /// Remove every packet
+                void clear();
+
+                /// @return the number of packets waiting
+                size_t size() const;
+
+                /// @return true if there are no packets waiting
+                bool empty() const;
+
+                iterator begin();
+                iterator end();
+
+            private:
+                /// The value in the index for a packet id that isn't in use
+                static constexpr uint16_t EMPTY = std::numeric_limits<uint16_t>::max();
+
+                /// Where each packet id is in the packets array, allocated when the first packet is added
+                std::vector<uint16_t> index;
+                /// The waiting packets
+                std::vector<PacketQueue> packets;
+                /// The sequence number given to the last packet added
+                uint64_t sequence{0};
             };
 
+            /**
+             * Report the outcome of a packet in the send queue if anyone is waiting for it.
+             * Only the first outcome is reported.
+             *
+             * @param queue The queued packet
+             * @param error Why the packet could not be delivered, or empty if it was delivered
+             */
+            static void complete(PacketQueue& queue, const std::string& error);
+
             /**
              * Open our data udp socket.
              *
@@ -253,13 +876,37 @@ namespace extension {
              */
             void open_announce(const sock_t& announce_target, const sock_t& bind_address);
 
+            /**
+             * Read and process every datagram that is waiting on the given socket.
+             * Where recvmmsg is available datagrams are read in batches into reused buffers.
+             *
+             * @param fd The socket to read from
+             */
+            void receive(fd_t fd);
+
+#ifdef __linux__
+            /**
+             * Read and process every datagram waiting on a socket that has UDP generic receive offload enabled.
+             * The kernel hands back runs of datagrams from the same sender as one buffer, which is split back into
+             * datagrams here so many fragments of a large packet can be read with a single system call.
+             *
+             * @param fd The socket to read from
+             *
+             * @return false if the datagrams couldn't be read this way, and coalescing has been turned off
+             */
+            bool receive_coalesced(fd_t fd);
+#endif  // __linux__
+
             /**
              * Processes the given packet and calls the callback if a packet was completed.
              *
-             * @param address Who the packet came from
-             * @param data    The data that was sent in this packet
+             * The datagram is only read during the call, so it can be a view into a larger receive buffer.
+             *
+             * @param address        Who the packet came from
+             * @param payload        The data that was sent in this packet
+             * @param payload_length The number of bytes in the packet
              */
-            void process_packet(const sock_t& address, std::vector<uint8_t>&& payload);
+            void process_packet(const sock_t& address, const uint8_t* payload, size_t payload_length);
 
             /**
              * Send an announce packet to our announce address.
@@ -268,32 +915,348 @@ namespace extension {
 
             /**
              * Retransmit waiting packets that failed to send.
+             * Only packets whose retransmit event is due are looked at.
              */
             void retransmit();
 
             /**
-             * Send an individual packet to an individual target.
+             * Schedule when a packet in the send queue next needs to be looked at by retransmit.
+             * The send queue mutex must be held.
+             *
+             * @param queue The packet to schedule
+             * @param when  When to look at the packet, the earliest of when a target should have acknowledged it by and
+             *              when we give up on it
+             */
+            void schedule_retransmit(PacketQueue& queue, std::chrono::steady_clock::time_point when);
+
+            /// A single datagram waiting to be transmitted
+            struct Datagram {
+                /// The bytes of the header for the datagram, with its packet number set
+                std::array<uint8_t, sizeof(DataPacketV3) - 1> header{};
+                /// How many bytes of the header are used, which depends on its version
+                size_t header_length{0};
+                /// The chunk of the payload this datagram carries
+                const uint8_t* data{nullptr};
+                /// The number of bytes in the chunk
+                size_t length{0};
+                /// Who the datagram is going to
+                const sock_t* target{nullptr};
+            };
+
+            /**
+             * Make a datagram for one chunk of a packet with its header written, but no data yet.
+             *
+             * @param target    The target to send the datagram to
+             * @param header    The header for this packet
+             * @param packet_no The packet number we are sending
+             *
+             * @return the datagram, its data still needs to be pointed at the chunk
+             */
+            Datagram make_datagram(const sock_t& target, const DataPacketV3& header, uint32_t packet_no) const;
+
+            /**
+             * Add the datagram for one chunk of a packet to a list of datagrams to transmit.
+             *
+             * @param datagrams The list of datagrams to add to
+             * @param target    The target to send the datagram to
+             * @param header    The header for this packet
+             * @param packet_no The packet number we are sending
+             * @param payload   The data bytes for the entire packet
+             * @param length    The number of bytes in the entire packet
+             */
+            void add_datagram(std::vector<Datagram>& datagrams,
+                              const sock_t& target,
+                              const DataPacketV3& header,
+                              uint32_t packet_no,
+                              const uint8_t* payload,
+                              const size_t& length) const;
+
+            /**
+             * Add the datagram for one chunk of a packet in the send queue, wherever the chunk's data is held.
              *
-             * @param target    The target to send the packet to
+             * @param datagrams The list of datagrams to add to
+             * @param target    The target to send the datagram to
+             * @param queue     The queued packet
              * @param header    The header for this packet
              * @param packet_no The packet number we are sending
+             */
+            void add_datagram(std::vector<Datagram>& datagrams,
+                              const sock_t& target,
+                              const PacketQueue& queue,
+                              const DataPacketV3& header,
+                              uint32_t packet_no) const;
+
+            /**
+             * Add the datagrams for every chunk of a packet to a list of datagrams to transmit.
+             *
+             * @param datagrams The list of datagrams to add to
+             * @param target    The target to send the datagrams to
+             * @param header    The header for this packet
              * @param payload   The data bytes for the entire packet
-             * @param reliable  If the packet is reliable (don't drop)
+             * @param length    The number of bytes in the entire packet
+             * @param acked     If given, chunks that have their bit set have been acknowledged and are skipped
+             */
+            void add_datagrams(std::vector<Datagram>& datagrams,
+                               const sock_t& target,
+                               const DataPacketV3& header,
+                               const uint8_t* payload,
+                               const size_t& length,
+                               const std::vector<uint8_t>* acked = nullptr) const;
+
+            /**
+             * Send the given datagrams on the data socket in as few system calls as possible.
+             *
+             * Where sendmmsg is available the datagrams are sent in batches, and where UDP generic segmentation offload
+             * is available consecutive full sized datagrams to the same target are given to the kernel as one buffer.
+             *
+             * @param datagrams The datagrams to send, datagrams to the same target should be next to each other
+             *
+             * @return The error number for each datagram, or 0 if it was sent
+             */
+            std::vector<int> transmit(const std::vector<Datagram>& datagrams);
+
+            /**
+             * Send a single datagram on the data socket with its own system call.
+             *
+             * @param datagram The datagram to send
+             *
+             * @return The error number, or 0 if it was sent
+             */
+            int transmit_one(const Datagram& datagram);
+
+            /**
+             * Send as many waiting chunks to a target as its congestion window and pacing rate allow.
+             * The send queue mutex must be held.
+             *
+             * @param target    The target to send to
+             * @param datagrams The list to add the datagrams to send to
+             * @param now       The current time
+             */
+            void pump(const std::shared_ptr<NetworkTarget>& target,
+                      std::vector<Datagram>& datagrams,
+                      std::chrono::steady_clock::time_point now);
+
+            /**
+             * Pump every target that has chunks waiting to be sent and transmit them.
+             */
+            void pump_all();
+
+            /**
+             * Make sure pump_all is run by the given time.
+             * The send queue mutex must be held.
+             *
+             * @param when When pump_all needs to run
+             */
+            void schedule_pump(std::chrono::steady_clock::time_point when);
+
+            /**
+             * Mark chunks of a paced packet as no longer in flight to a target, so they are sent again.
+             * Losing chunks shrinks the target's congestion window, at most once per round trip.
+             * The send queue mutex must be held.
+             *
+             * @param target The target the chunks were sent to
+             * @param queue  The packet the chunks belong to
+             * @param it     The packet's state for the target
+             * @param lost   A bitset of the chunks that were lost, or nullptr if every unacknowledged chunk is
+             * @param offset The first byte of the packet's bitsets that lost covers
+             * @param size   The number of bytes in lost
+             *
+             * @return How many chunks were in flight and are now lost
+             */
+            size_t lose_chunks(NetworkTarget& target,
+                               PacketQueue& queue,
+                               PacketQueue::PacketTarget& it,
+                               const uint8_t* lost,
+                               size_t offset = 0,
+                               size_t size   = 0);
+
+            /**
+             * Mark chunks of a packet as acknowledged by a target.
+             * The send queue mutex must be held.
+             *
+             * @param it     The packet's state for the target
+             * @param paced  If the packet is paced, so chunks that were in flight are counted as arrived
+             * @param count  How many chunks are in the packet
+             * @param offset The first byte of the packet's bitsets that bits covers
+             * @param bits   A bitset of the chunks that were acknowledged, or nullptr if every chunk was
+             * @param size   The number of bytes of the packet's bitsets that bits covers
+             *
+             * @return How many chunks were in flight and have now arrived
              */
-            void send_packet(const sock_t& target,
-                             DataPacket header,
-                             uint16_t packet_no,
-                             const std::vector<uint8_t>& payload,
-                             const bool& reliable);
+            static size_t ack_chunks(PacketQueue::PacketTarget& it,
+                                     bool paced,
+                                     uint32_t count,
+                                     size_t offset,
+                                     const uint8_t* bits,
+                                     size_t size);
 
             /**
-             * Get the map key for this socket address.
+             * Work out how many chunks of a packet in the send queue are ready to send.
              *
-             * @param address Who the packet came from
+             * @param queue The queued packet
              *
-             * @return The map key for this socket
+             * @return every chunk, or for a streamed packet the chunks that have been completely written
              */
-            static std::array<uint16_t, 9> udp_key(const sock_t& address);
+            uint32_t ready_chunks(const PacketQueue& queue) const;
+
+            /**
+             * Work out how many more bytes the writer of a streamed packet can write before it should wait.
+             * About two congestion windows are buffered, enough for one window in flight and another ready to go.
+             * The send queue mutex must be held.
+             *
+             * @param queue The streamed packet
+             *
+             * @return the number of bytes that can be written, or zero if the writer should wait
+             */
+            size_t stream_room(const PacketQueue& queue) const;
+
+            /**
+             * Free the chunks of a streamed packet that every target has acknowledged, and let the writer know if that
+             * made room for more.
+             * The send queue mutex must be held.
+             *
+             * @param queue The streamed packet
+             */
+            void release_chunks(PacketQueue& queue);
+
+            /**
+             * Send an ack to a target with every chunk of a packet that we have received so far.
+             * Version 3 acks carry as much of the bitset as fits in a datagram, around the newest chunk.
+             * The target's assembler mutex must be held.
+             *
+             * @param target    The target that is sending us the packet
+             * @param packet_id The packet id of the packet
+             * @param assembler The packet's assembler, its ack timer is cleared
+             */
+            void send_ack(const NetworkTarget& target, uint32_t packet_id, NetworkTarget::Assembler& assembler);
+
+            /**
+             * Send an ack to a target saying that we have every chunk of a packet.
+             *
+             * @param target The target that sent us the packet
+             * @param packet The header of a chunk of the packet
+             */
+            void send_complete_ack(const NetworkTarget& target, const DataPacketV3& packet);
+
+            /**
+             * Send nacks to a target asking for chunks of a packet to be sent again.
+             *
+             * @param target The target that is sending us the packet
+             * @param packet The header of a chunk of the packet
+             * @param lost   A bitset of the chunks that need to be sent again
+             */
+            void send_nack(const NetworkTarget& target, const DataPacketV3& packet, const std::vector<uint8_t>& lost);
+
+            /**
+             * Send an announce packet in every protocol version we understand.
+             *
+             * @param to Who to send the announce packets to
+             *
+             * @return false if any of them failed to send
+             */
+            bool send_announce(const sock_t& to);
+
+            /**
+             * Make sure flush_acks is run by the given time.
+             *
+             * @param when When flush_acks needs to run
+             */
+            void schedule_ack(std::chrono::steady_clock::time_point when);
+
+            /**
+             * Send every held back ack that is due.
+             */
+            void flush_acks();
+
+            /**
+             * Allocate a packet id for a new message and if it is reliable, add it to the send queue so it can be
+             * retransmitted until every target acknowledges it.
+             *
+             * If the packet is large enough and every target can decompress it, it is compressed first.
+             *
+             * @param hash        The identifying hash for the data
+             * @param payload     The bytes of the entire packet, replaced with the bytes to send if it is compressed
+             * @param length      The number of bytes in the entire packet, replaced with the number to send if it is
+             *                    compressed
+             * @param target      Who we are sending to (blank means everyone)
+             * @param reliable    If the delivery of the data should be ensured
+             * @param paced       If the chunks will be sent through each target's congestion window by pump
+             * @param streamed    If the payload will be written a piece at a time rather than given now
+             * @param on_complete Called when every target has acknowledged the packet, or it fails to be delivered
+             * @param timeout     How long to wait for every target to acknowledge the packet, zero waits forever
+             *
+             * @return The header for the datagrams of this message, version 3 if every target has announced it
+             */
+            DataPacketV3 queue_packet(const uint64_t& hash,
+                                    std::shared_ptr<const uint8_t>& payload,
+                                    size_t& length,
+                                    const std::string& target,
+                                    bool reliable,
+                                    bool paced,
+                                    bool streamed,
+                                    SendCallback on_complete,
+                                    std::chrono::steady_clock::duration timeout);
+
+            /**
+             * Compress the payload of a packet with LZ4, if that makes it smaller.
+             *
+             * @param payload The bytes of the packet, replaced with the compressed bytes if it was compressed
+             * @param length  The number of bytes in the packet, replaced with the compressed length if it was
+             *                compressed
+             *
+             * @return true if the payload was compressed
+             */
+            bool compress(std::shared_ptr<const uint8_t>& payload, size_t& length);
+
+            /**
+             * Decompress the assembled payload of a data packet.
+             *
+             * @param compression How the payload was compressed
+             * @param payload     The bytes of the packet, replaced with the original bytes
+             *
+             * @return false if the payload could not be decompressed and has to be dropped
+             */
+            bool decompress(const Compression& compression, std::vector<uint8_t>& payload) const;
+
+            /**
+             * Join or leave a multicast group on the announce socket.
+             *
+             * @param group The multicast group
+             * @param join  true to join the group, false to leave it
+             *
+             * @return false if the system wouldn't let us
+             */
+            bool set_membership(const sock_t& group, bool join);
+
+            /**
+             * Join the type groups for the types we are listening to and leave the rest.
+             * If one can't be joined we leave them all and stop announcing them, so data comes to the announce group.
+             * The groups mutex must be held.
+             */
+            void update_memberships();
+
+            /**
+             * Rebuild the interest filter from the types we are listening to and put it in our announce packet.
+             * The groups mutex must be held.
+             */
+            void update_interest();
+
+            /**
+             * Have the next call to process send our announce packet, as it has changed in a way our peers should
+             * hear about before the next regular announce.
+             */
+            void announce_soon();
+
+            /**
+             * Find the multicast group that untargeted data of a type is sent to.
+             * The target mutex must be held.
+             *
+             * @param hash     The identifying hash for the data
+             * @param reliable If the data is reliable, so every target must say which types they listen to
+             *
+             * @return The group, or nullptr if data is not being spread over groups by type
+             */
+            const sock_t* type_group(const uint64_t& hash, bool reliable) const;
 
             /**
              * Remove a target from our list of targets.
@@ -310,15 +1273,87 @@ namespace extension {
             /// The largest packet of data we will transmit, based on our IP version and MTU
             uint16_t packet_data_mtu{1000};
 
-            // Our announce packet
+            // Our announce packets, one for each protocol version
             std::vector<uint8_t> announce_packet;
+            // The version 3 announce changes with the types we listen to, so it is guarded by the groups mutex
+            std::vector<uint8_t> announce_packet_v3;
+
+            /// An source for packet IDs to make sure they are semi unique, version 2 packets use the lower 16 bits
+            uint32_t packet_id_source{0};
+
+            /// The most datagrams we read from a socket in one system call
+            static constexpr size_t RECEIVE_BATCH_SIZE = 64;
+            /// Spare buffers to receive datagrams into
+            BufferPool receive_pool;
+
+            /// The most coalesced buffers we read from the data socket in one system call
+            static constexpr size_t COALESCED_BATCH_SIZE = 8;
+            /// The largest buffer of coalesced datagrams the kernel can give us
+            static constexpr size_t MAX_COALESCED_SIZE = 65535;
+            /// Protects the coalesced buffers and the backlog, as process can be called from more than one thread
+            std::mutex coalesced_mutex;
+            /// The buffers coalesced datagrams are read into, reused between reads
+            std::array<std::vector<uint8_t>, COALESCED_BATCH_SIZE> coalesced_buffers;
+            /// If the kernel is joining datagrams on the data socket into larger buffers for us
+            std::atomic<bool> gro_enabled{false};
+            /// Datagrams the kernel joined together with ones we could read, that were past the receive limit
+            std::deque<std::pair<sock_t, std::vector<uint8_t>>> receive_backlog;
+
+            /// The most messages we give to the kernel in one sendmmsg call
+            static constexpr size_t MAX_SEND_MESSAGES = 1024;
+            /// The most datagrams the kernel will segment out of one buffer
+            static constexpr size_t MAX_GSO_SEGMENTS = 64;
+            /// If we can hand the kernel one large buffer to split into datagrams, cleared if it ever fails
+            std::atomic<bool> gso_enabled{true};
+            /// How many datagrams have been sent on the data socket
+            std::atomic<uint64_t> datagrams_sent{0};
+            /// How many system calls it took to send them
+            std::atomic<uint64_t> send_calls{0};
+            /// How many acks have been sent for chunks of reliable packets
+            std::atomic<uint64_t> acks_sent{0};
+            /// How many packets were sent compressed
+            std::atomic<uint64_t> packets_compressed{0};
+            /// How many packets were compressed but sent as they were
+            std::atomic<uint64_t> packets_incompressible{0};
+            /// How many bytes the packets that were sent compressed had before they were compressed
+            std::atomic<uint64_t> compression_input{0};
+            /// How many bytes the packets that were sent compressed had after they were compressed
+            std::atomic<uint64_t> compression_output{0};
+            /// How many times a peer was left out of a packet as it doesn't listen to the packet's type
+            std::atomic<uint64_t> packets_skipped{0};
 
-            /// An source for packet IDs to make sure they are semi unique
-            uint16_t packet_id_source{0};
+            /// The largest data packet we accept unless we are told otherwise
+            static constexpr size_t DEFAULT_MAX_MESSAGE_SIZE = size_t(256) * 1024 * 1024;
+            /// Acks are sent after this many chunks of a packet arrive, rather than for every chunk
+            static constexpr uint32_t ACK_EVERY = 16;
+            /// The most bytes of bitset in a version 3 ack or nack, so it fits in the smallest receive buffer
+            static constexpr size_t MAX_ACK_BITSET = 1024;
+            /// How long in milliseconds an ack can be held back waiting for more chunks to arrive
+            static constexpr int ACK_DELAY = 2;
+            /// How long in milliseconds a partly assembled packet is kept at least without any new chunks, streams can
+            /// go quiet for a while when their writer falls behind
+            static constexpr int ASSEMBLY_TIMEOUT = 5000;
+            /// When the soonest held back ack is due, so process can check without taking the locks
+            std::atomic<std::chrono::steady_clock::rep> next_ack{
+                std::chrono::steady_clock::time_point::max().time_since_epoch().count()};
 
             /// The callback to execute when a data packet is completed
             std::function<void(const NetworkTarget&, const uint64_t&, const bool&, std::vector<uint8_t>&&)>
                 packet_callback;
+            /// The filter deciding which types of data packet we want, if not set we want them all
+            std::function<bool(const uint64_t&)> packet_filter;
+            /// The filter deciding which types of data packet are streamed, if not set none are
+            std::function<bool(const uint64_t&)> stream_filter;
+            /// How many more datagrams can be read, if not set there is no limit
+            std::function<size_t()> receive_limit;
+            /// The fewest bytes a data packet can have and be compressed, 0 never compresses anything
+            std::atomic<size_t> compression_threshold{0};
+            /// The largest data packet we accept, 0 accepts any size
+            std::atomic<size_t> max_message_size{DEFAULT_MAX_MESSAGE_SIZE};
+            /// The filter deciding which types of data packet can be compressed, if not set they all can be
+            std::function<bool(const uint64_t&)> compression_filter;
+            /// The callback to execute when the next piece of a streamed packet arrives
+            StreamCallback stream_callback;
             /// The callback to execute when a node joins the network
             std::function<void(const NetworkTarget&)> join_callback;
             /// The callback to execute when a node leaves the network
@@ -337,17 +1372,64 @@ namespace extension {
             /// A mutex to guard modifications to the send queue
             std::mutex send_queue_mutex;
 
-            /// A map from packet_id to allow resending reliable data
-            std::map<uint16_t, PacketQueue> send_queue;
+            /// The reliable packets by packet_id to allow resending them
+            SendQueue send_queue;
+
+            /// When packets in the send queue need to be looked at again, soonest first
+            std::priority_queue<RetransmitEvent, std::vector<RetransmitEvent>, std::greater<>> retransmit_events;
+            /// When the soonest retransmit event is due, so process can check without taking the locks
+            std::atomic<std::chrono::steady_clock::rep> next_retransmit{
+                std::chrono::steady_clock::time_point::max().time_since_epoch().count()};
+
+            /// How many multicast groups untargeted data should be spread over from the next reset
+            std::atomic<uint8_t> type_group_count{0};
+            /// The multicast groups untargeted data is spread over, guarded by both the target and groups mutexes
+            std::vector<sock_t> type_groups;
+            /// If we couldn't join a type group so have stopped using them until the next reset
+            std::atomic<bool> type_groups_failed{false};
+            /// A mutex to guard which types we listen to and which type groups we have joined
+            /// NOTE: when both are needed the target mutex must be locked first
+            std::mutex groups_mutex;
+            /// The types of data we are listening to
+            std::set<uint64_t> listened_types;
+            /// If we are listening to every type of data
+            bool listening_all{false};
+            /// Which of the type groups the announce socket has joined
+            std::vector<bool> joined_groups;
+            /// The address the announce socket is bound to, which picks the interface multicast groups are joined on
+            sock_t membership_interface{};
+            /// If we tell our peers which types we listen to
+            std::atomic<bool> advertise_interest{false};
+            /// The types we listen to as we tell our peers, guarded by the groups mutex
+            util::network::InterestFilter<INTEREST_FILTER_SIZE> interest;
+            /// Counts up each time our interest filter changes, guarded by the groups mutex
+            uint16_t interest_version{0};
+            /// If our announce packet should be sent on the next process without waiting for the regular announce
+            std::atomic<bool> announce_due{false};
+
+            /// How reliable data is paced to each target
+            std::atomic<CongestionControl> congestion_control{CongestionControl::AIMD};
+            /// When targets next have chunks that their pacing rate allows to be sent
+            std::atomic<std::chrono::steady_clock::rep> next_pump{
+                std::chrono::steady_clock::time_point::max().time_since_epoch().count()};
+
+            /// The smallest the congestion window can shrink to
+            static constexpr double MIN_WINDOW = 2;
+            /// The largest the congestion window can grow to
+            static constexpr double MAX_WINDOW = 4096;
+            /// The most datagrams that can be sent in one burst while pacing
+            static constexpr double PACING_BURST = 16;
+            /// How much faster than one window per round trip we pace, so the window can be filled
+            static constexpr double PACING_GAIN = 1.25;
 
             /// A list of targets that we are connected to on the network
             std::list<std::shared_ptr<NetworkTarget>> targets;
 
-            /// A map of string names to targets with that name
-            std::multimap<std::string, std::shared_ptr<NetworkTarget>, std::less<>> name_target;
+            /// A map of string names to the targets with that name
+            util::OpenHashMap<std::string, std::vector<std::shared_ptr<NetworkTarget>>> name_target;
 
             /// A map of ip/port pairs to the network target they belong to
-            std::map<std::array<uint16_t, 9>, std::shared_ptr<NetworkTarget>> udp_target;
+            util::OpenHashMap<sock_t::key_t, std::shared_ptr<NetworkTarget>, sock_t::key_t::Hash> udp_target;
         };
 
     }  // namespace network
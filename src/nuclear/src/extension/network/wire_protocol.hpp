@@ -23,6 +23,7 @@
 #ifndef NUCLEAR_EXTENSION_NETWORK_WIRE_PROTOCOL_HPP
 #define NUCLEAR_EXTENSION_NETWORK_WIRE_PROTOCOL_HPP
 
+#include <cstddef>
 #include <cstdint>
 
 // These macros are used to pack the structs so that they are sent over the network in the correct format
@@ -43,29 +44,82 @@ namespace extension {
          */
         enum Type : uint8_t { ANNOUNCE = 1, LEAVE = 2, DATA = 3, DATA_RETRANSMISSION = 4, ACK = 5, NACK = 6 };
 
+        /**
+         * The versions of the NUClear network protocol.
+         * Every peer announces itself in each version it understands, and data is only sent as version 3 to peers that
+         * have announced it.
+         */
+        enum Version : uint8_t {
+            /// 16 bit packet ids and counts
+            V2 = 0x02,
+            /// 32 bit packet ids and counts, with the total length of the data so it can be allocated up front, and
+            /// optional features such as compression
+            V3 = 0x03
+        };
+
+        /**
+         * Optional features that a peer announces it supports, as bits of its version 3 announce packet.
+         */
+        enum Feature : uint8_t {
+            /// Data packets compressed with LZ4 can be decompressed
+            FEATURE_LZ4 = 0x01,
+            /// The announce says which types this node listens to, peers without it are sent every type
+            FEATURE_INTEREST = 0x02
+        };
+
+        /// How many bytes the Bloom filter of listened to types in a version 3 announce packet takes up
+        constexpr size_t INTEREST_FILTER_SIZE = 256;
+
+        /**
+         * How the data of a version 3 data packet has been compressed.
+         */
+        enum Compression : uint8_t {
+            /// The data is sent as it is
+            COMPRESSION_NONE = 0,
+            /// The 8 byte length of the original data, followed by the data compressed into a single LZ4 block
+            COMPRESSION_LZ4 = 1
+        };
+
         /**
          * The header that is sent with every packet.
          */
         PACK(struct PacketHeader {
-            explicit PacketHeader(const Type& t) : type(t) {}
+            explicit PacketHeader(const Type& t, const Version& v = V2) : version(v), type(t) {}
 
             /// Radioactive symbol in UTF8
             // NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,modernize-avoid-c-arrays)
             uint8_t header[3] = {0xE2, 0x98, 0xA2};
             /// The NUClear networking version
-            uint8_t version = 0x02;
+            uint8_t version;
             /// The type of packet
             Type type;
         });
 
         PACK(struct AnnouncePacket
              : PacketHeader {
-                 AnnouncePacket() : PacketHeader(ANNOUNCE) {}
+                 explicit AnnouncePacket(const Version& v = V2) : PacketHeader(ANNOUNCE, v) {}
 
                  // A null terminated string name for this node (&name)
                  char name{0};
              });
 
+        PACK(struct AnnouncePacketV3
+             : PacketHeader {
+                 AnnouncePacketV3() : PacketHeader(ANNOUNCE, V3) {}
+
+                 // The optional features this node supports, a bitset of Feature
+                 uint8_t features{0};
+                 // How many multicast groups this node spreads untargeted data over by type, 0 if it doesn't
+                 uint8_t type_groups{0};
+                 // Counts up each time the interest filter changes, so an older announce can't undo a newer one
+                 uint16_t interest_version{0};
+                 // A Bloom filter of the type hashes this node listens to, if it has FEATURE_INTEREST
+                 // NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,modernize-avoid-c-arrays)
+                 uint8_t interest[INTEREST_FILTER_SIZE] = {};
+                 // A null terminated string name for this node (&name)
+                 char name{0};
+             });
+
         PACK(struct LeavePacket : PacketHeader{LeavePacket(): PacketHeader(LEAVE){}});
 
         PACK(struct DataPacket
@@ -112,6 +166,59 @@ namespace extension {
                  uint8_t packets{0};
              });
 
+        PACK(struct DataPacketV3
+             : PacketHeader {
+                 DataPacketV3() : PacketHeader(DATA, V3) {}
+
+                 // A semi-unique identifier for this packet group
+                 uint32_t packet_id{0};
+                 // What packet number this is within the group
+                 uint32_t packet_no{0};
+                 // How many packets there are in the group
+                 uint32_t packet_count{1};
+                 // If this packet is reliable and should be acked
+                 bool reliable{false};
+                 // How the data of the whole group was compressed, it is decompressed once the group is assembled
+                 Compression compression{COMPRESSION_NONE};
+                 // The 64 bit hash to identify the data type
+                 uint64_t hash{0};
+                 // The total number of bytes in the group, so the receiver can allocate it all at once
+                 uint64_t length{0};
+                 // The data (access using &data)
+                 char data{0};
+             });
+
+        PACK(struct ACKPacketV3
+             : PacketHeader {
+                 ACKPacketV3() : PacketHeader(ACK, V3) {}
+
+                 /// The packet group identifier we are acknowledging
+                 uint32_t packet_id{0};
+                 /// How many packets there are in the group
+                 uint32_t packet_count{1};
+                 /// Every packet before this one has been received
+                 uint32_t received_below{0};
+                 /// The index of the packet the bitset starts at, a multiple of 8
+                 uint32_t offset{0};
+                 /// A bitset of which packets we have received from offset on, as many bytes as fit (access using
+                 /// &packets)
+                 uint8_t packets{0};
+             });
+
+        PACK(struct NACKPacketV3
+             : PacketHeader {
+                 NACKPacketV3() : PacketHeader(NACK, V3) {}
+
+                 /// The packet group identifier we are acknowledging
+                 uint32_t packet_id{0};
+                 /// How many packets there are in the group
+                 uint32_t packet_count{1};
+                 /// The index of the packet the bitset starts at, a multiple of 8
+                 uint32_t offset{0};
+                 /// A bitset of which packets need to be sent again from offset on (access using &packets)
+                 uint8_t packets{0};
+             });
+
     }  // namespace network
 }  // namespace extension
 }  // namespace NUClear
@@ -0,0 +1,238 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NUCLEAR_UTIL_OPENHASHMAP_HPP
+#define NUCLEAR_UTIL_OPENHASHMAP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace NUClear {
+namespace util {
+
+    /**
+     * A hash map that stores its entries in a single flat array using open addressing with linear probing.
+     *
+     * Lookups hash the key once and then walk neighbouring slots, comparing the stored hash before the key, so a hit
+     * is usually a single cache line rather than the chain of nodes a std::map walks.
+     * Entries are removed by shifting the following entries back, so there are no tombstones to slow lookups down.
+     *
+     * Inserting or erasing may move entries, so pointers returned by find are only valid until the map is modified.
+     *
+     * @tparam Key   the type of the key, must be default constructible and equality comparable
+     * @tparam Value the type of the value, must be default constructible
+     * @tparam Hash  the hash function for the key
+     */
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class OpenHashMap {
+    public:
+        /// A single entry in the table
+        struct Slot {
+            /// The hash of the key
+            size_t hash{0};
+            /// If this slot holds an entry
+            bool used{false};
+            /// The key of the entry
+            Key key{};
+            /// The value of the entry
+            Value value{};
+        };
+
+        /**
+         * Find the value stored for a key.
+         *
+         * @param key the key to look for
+         *
+         * @return a pointer to the value or nullptr if the key isn't in the map
+         */
+        Value* find(const Key& key) {
+            const size_t slot = locate(key, Hash()(key));
+            return slot == NOT_FOUND ? nullptr : &slots[slot].value;
+        }
+
+        /// @copydoc find
+        const Value* find(const Key& key) const {
+            const size_t slot = locate(key, Hash()(key));
+            return slot == NOT_FOUND ? nullptr : &slots[slot].value;
+        }
+
+        /**
+         * Get the value stored for a key, inserting a default constructed value if it isn't there.
+         *
+         * @param key the key to look for
+         *
+         * @return the value for the key
+         */
+        Value& operator[](const Key& key) {
+            const size_t hash = Hash()(key);
+            const size_t slot = locate(key, hash);
+            if (slot != NOT_FOUND) {
+                return slots[slot].value;
+            }
+
+            // Keep the table at most 3/4 full so probe sequences stay short
+            if ((count + 1) * 4 > slots.size() * 3) {
+                rehash(slots.empty() ? MIN_CAPACITY : slots.size() * 2);
+            }
+
+            // Take the first free slot after our home slot
+            const size_t mask = slots.size() - 1;
+            size_t i          = hash & mask;
+            while (slots[i].used) {
+                i = (i + 1) & mask;
+            }
+            slots[i].hash = hash;
+            slots[i].used = true;
+            slots[i].key  = key;
+            ++count;
+            return slots[i].value;
+        }
+
+        /**
+         * Remove a key from the map.
+         *
+         * @param key the key to remove
+         *
+         * @return true if the key was in the map
+         */
+        bool erase(const Key& key) {
+            size_t hole = locate(key, Hash()(key));
+            if (hole == NOT_FOUND) {
+                return false;
+            }
+
+            // Shift back any entries after the hole that would no longer be found once it is empty
+            const size_t mask = slots.size() - 1;
+            for (size_t i = (hole + 1) & mask; slots[i].used; i = (i + 1) & mask) {
+                const size_t home = slots[i].hash & mask;
+
+                // Only move this entry if its home slot is not between the hole and where it is now
+                if (((i - home) & mask) >= ((i - hole) & mask)) {
+                    slots[hole] = std::move(slots[i]);
+                    hole        = i;
+                }
+            }
+
+            slots[hole] = Slot();
+            --count;
+            return true;
+        }
+
+        /**
+         * Remove every entry from the map, keeping the storage.
+         */
+        void clear() {
+            for (auto& slot : slots) {
+                slot = Slot();
+            }
+            count = 0;
+        }
+
+        /**
+         * @return the number of entries in the map
+         */
+        size_t size() const {
+            return count;
+        }
+
+        /**
+         * @return true if there are no entries in the map
+         */
+        bool empty() const {
+            return count == 0;
+        }
+
+        /**
+         * Call a function for every entry in the map.
+         * The map must not be modified by the function.
+         *
+         * @param f the function to call with the key and the value of each entry
+         */
+        template <typename F>
+        void for_each(F&& f) {
+            for (auto& slot : slots) {
+                if (slot.used) {
+                    f(slot.key, slot.value);
+                }
+            }
+        }
+
+    private:
+        /// The returned index when a key isn't in the table
+        static constexpr size_t NOT_FOUND = ~size_t(0);
+        /// The smallest number of slots in a table that holds anything, always a power of two
+        static constexpr size_t MIN_CAPACITY = 16;
+
+        /**
+         * Find the slot holding a key.
+         *
+         * @param key  the key to look for
+         * @param hash the hash of the key
+         *
+         * @return the index of the slot or NOT_FOUND
+         */
+        size_t locate(const Key& key, const size_t& hash) const {
+            if (count == 0) {
+                return NOT_FOUND;
+            }
+            const size_t mask = slots.size() - 1;
+            for (size_t i = hash & mask; slots[i].used; i = (i + 1) & mask) {
+                if (slots[i].hash == hash && slots[i].key == key) {
+                    return i;
+                }
+            }
+            return NOT_FOUND;
+        }
+
+        /**
+         * Move every entry into a new table with the given number of slots.
+         *
+         * @param capacity the new number of slots, must be a power of two
+         */
+        void rehash(size_t capacity) {
+            std::vector<Slot> old(capacity);
+            std::swap(old, slots);
+
+            const size_t mask = capacity - 1;
+            for (auto& slot : old) {
+                if (slot.used) {
+                    size_t i = slot.hash & mask;
+                    while (slots[i].used) {
+                        i = (i + 1) & mask;
+                    }
+                    slots[i] = std::move(slot);
+                }
+            }
+        }
+
+        /// The slots of the table, the size is always zero or a power of two
+        std::vector<Slot> slots;
+        /// How many slots are in use
+        size_t count{0};
+    };
+
+}  // namespace util
+}  // namespace NUClear
+
+#endif  // NUCLEAR_UTIL_OPENHASHMAP_HPP
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NUCLEAR_UTIL_NETWORK_INTERESTFILTER_HPP
+#define NUCLEAR_UTIL_NETWORK_INTERESTFILTER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace NUClear {
+namespace util {
+    namespace network {
+
+        /**
+         * A Bloom filter over 64 bit type hashes, so a node can tell its peers which types it listens to in a fixed
+         * amount of space.
+         *
+         * Each hash sets four bits, one chosen by each 16 bit quarter of the hash modulo the number of bits. Type
+         * hashes are already well mixed so they don't need hashing again, and since peers test each other's filters
+         * this layout is part of the wire protocol.
+         * A filter can say it contains a hash that was never inserted, but never the other way around.
+         *
+         * @tparam Bytes how many bytes the filter takes up, a power of two that is at least 8 and at most 8192
+         */
+        template <size_t Bytes>
+        class InterestFilter {
+            static_assert(Bytes >= 8 && (Bytes & (Bytes - 1)) == 0, "The filter must be a power of two of bytes");
+            static_assert(Bytes <= 8192, "Each bit must be chosen from a 16 bit quarter of the hash");
+
+        public:
+            /**
+             * Check if a hash might have been inserted.
+             *
+             * @param hash the type hash to check
+             *
+             * @return false if the hash was definitely not inserted, true if it probably was
+             */
+            bool contains(const uint64_t& hash) const {
+                for (int i = 0; i < 4; ++i) {
+                    const size_t b = bit(hash, i);
+                    if ((bits[b / 8] & uint8_t(1 << (b % 8))) == 0) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            /**
+             * Add a hash to the filter.
+             *
+             * @param hash the type hash to add
+             */
+            void insert(const uint64_t& hash) {
+                for (int i = 0; i < 4; ++i) {
+                    const size_t b = bit(hash, i);
+                    bits[b / 8] |= uint8_t(1 << (b % 8));
+                }
+            }
+
+            /**
+             * Make the filter contain every hash.
+             */
+            void fill() {
+                bits.fill(0xFF);
+            }
+
+            /**
+             * Remove every hash from the filter.
+             */
+            void clear() {
+                bits.fill(0);
+            }
+
+            /**
+             * @return the bytes of the filter, as they are sent to peers
+             */
+            const uint8_t* data() const {
+                return bits.data();
+            }
+
+            /**
+             * @return the bytes of the filter, to be filled in from one a peer sent
+             */
+            uint8_t* data() {
+                return bits.data();
+            }
+
+            /// How many bytes the filter takes up
+            static constexpr size_t size() {
+                return Bytes;
+            }
+
+        private:
+            /**
+             * @param hash  the type hash
+             * @param index which of the hash's four bits to find
+             *
+             * @return the index of the bit
+             */
+            static size_t bit(const uint64_t& hash, int index) {
+                return size_t((hash >> (16 * index)) & 0xFFFF) % (Bytes * 8);
+            }
+
+            /// The bits of the filter, the lowest bit of the first byte is bit 0
+            std::array<uint8_t, Bytes> bits{};
+        };
+
+    }  // namespace network
+}  // namespace util
+}  // namespace NUClear
+
+#endif  // NUCLEAR_UTIL_NETWORK_INTERESTFILTER_HPP
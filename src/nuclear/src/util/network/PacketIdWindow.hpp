@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NUCLEAR_UTIL_NETWORK_PACKETIDWINDOW_HPP
+#define NUCLEAR_UTIL_NETWORK_PACKETIDWINDOW_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace NUClear {
+namespace util {
+    namespace network {
+
+        /**
+         * Remembers which of the most recent packet ids have been seen, so duplicates can be found in constant time.
+         *
+         * The window is a bitmap anchored at the highest id seen so far, where newer and older are worked out modulo
+         * the size of the id type so the window carries on across wrap around.
+         * Ids more than half the id space ahead of the highest id are treated as old, and ids that have fallen out of
+         * the back of the window are reported as unseen, so a new packet is never mistaken for a duplicate.
+         * Ids must be kept at their full width, as ids that are truncated to fewer bits can be mistaken for ones that
+         * are much newer or older.
+         *
+         * @tparam Id   the unsigned integer type of the packet ids
+         * @tparam Size how many ids the window covers, a power of two that is a multiple of 64 and at most half the
+         *              id space
+         */
+        template <typename Id, size_t Size>
+        class PacketIdWindow {
+            static_assert(std::is_unsigned<Id>::value, "Packet ids must be unsigned so they wrap around");
+            static_assert(Size % 64 == 0 && (Size & (Size - 1)) == 0,
+                          "The window must be a power of two of at least 64 ids");
+
+            /// Ids up to this far ahead of the highest id are newer, any further ahead are older
+            static constexpr Id half = Id(std::numeric_limits<Id>::max() / 2 + 1);
+            static_assert(Size <= half, "The window can cover at most half of the id space");
+
+        public:
+            /**
+             * Check if an id has been seen.
+             *
+             * @param id the packet id to check
+             *
+             * @return true if the id is in the window and has been seen
+             */
+            bool contains(Id id) const {
+                return !empty && Id(highest - id) < Size && (bits[(id % Size) / 64] & bit(id)) != 0;
+            }
+
+            /**
+             * Record that an id has been seen, sliding the window forward if it is newer than any seen before.
+             *
+             * @param id the packet id that was seen
+             */
+            void insert(Id id) {
+                const Id ahead = Id(id - highest);
+
+                // Ids up to half the id space ahead are newer, the window slides forward forgetting what it passes
+                if (empty || (ahead != 0 && ahead < half)) {
+                    if (empty || ahead >= Size) {
+                        bits.fill(0);
+                    }
+                    else {
+                        for (Id i = Id(highest + 1); i != id; ++i) {
+                            bits[(i % Size) / 64] &= ~bit(i);
+                        }
+                    }
+                    highest = id;
+                    empty   = false;
+                }
+                // Ids that have fallen out of the back of the window can't be recorded
+                else if (Id(highest - id) >= Size) {
+                    return;
+                }
+
+                bits[(id % Size) / 64] |= bit(id);
+            }
+
+            /**
+             * Forget every id that has been seen.
+             */
+            void clear() {
+                bits.fill(0);
+                highest = 0;
+                empty   = true;
+            }
+
+        private:
+            /**
+             * @param id the packet id
+             *
+             * @return the bit for the id within its word
+             */
+            static uint64_t bit(Id id) {
+                return uint64_t(1) << (id % 64);
+            }
+
+            /// One bit for each id in the window, indexed by the id modulo the window size
+            std::array<uint64_t, Size / 64> bits{};
+            /// The newest id that has been seen
+            Id highest{0};
+            /// If no id has been seen yet
+            bool empty{true};
+        };
+
+    }  // namespace network
+}  // namespace util
+}  // namespace NUClear
+
+#endif  // NUCLEAR_UTIL_NETWORK_PACKETIDWINDOW_HPP
@@ -0,0 +1,80 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NUCLEAR_UTIL_NETWORK_CHUNK_STRIDE_HPP
+#define NUCLEAR_UTIL_NETWORK_CHUNK_STRIDE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace NUClear {
+namespace util {
+    namespace network {
+
+        /**
+         * Works out how large every chunk of a packet except the last is, from any one chunk of a packet that says how
+         * long it is in total.
+         *
+         * The chunks before the last must all be the same size and fill all but the last, shorter, part of the
+         * packet, so a chunk that doesn't agree with the length and count it was sent with is corrupt.
+         *
+         * @param length       The total length of the packet that the chunk says it is part of
+         * @param packet_count How many chunks the chunk says the packet was split into
+         * @param last         If this is the last chunk of the packet
+         * @param chunk        The size of this chunk
+         *
+         * @return the size of every chunk except the last, or 0 if the chunk doesn't agree with the length and count
+         */
+        inline size_t chunk_stride(const uint64_t& length,
+                                   const uint32_t& packet_count,
+                                   const bool& last,
+                                   const size_t& chunk) {
+
+            // A packet in a single chunk has no stride
+            if (packet_count < 2) {
+                return 0;
+            }
+
+            // The last chunk is whatever is left after the others, so the others share the rest evenly
+            const uint64_t before = packet_count - 1;
+            uint64_t stride       = chunk;
+            if (last) {
+                if (length < chunk || (length - chunk) % before != 0) {
+                    return 0;
+                }
+                stride = (length - chunk) / before;
+            }
+
+            // The chunks before the last must fit in the length and leave less than a whole chunk for the last one
+            if (stride == 0 || length / before < stride || length - before * stride >= stride) {
+                return 0;
+            }
+
+            return size_t(stride);
+        }
+
+    }  // namespace network
+}  // namespace util
+}  // namespace NUClear
+
+#endif  // NUCLEAR_UTIL_NETWORK_CHUNK_STRIDE_HPP
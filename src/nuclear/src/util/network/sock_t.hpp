@@ -24,6 +24,8 @@
 #define NUCLEAR_UTIL_NETWORK_SOCK_T_HPP
 
 #include <array>
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
 
 #include "../platform.hpp"
@@ -50,6 +52,52 @@ namespace util {
                 }
             }
 
+            /// The address and port in a fixed form along with its hash, so it can be used to look up the peer
+            struct key_t {
+                /// The ipv6 address (or ipv4 address in the last two words) followed by the port
+                std::array<uint16_t, 9> words{};
+                /// The hash of the words, calculated once when the key is made
+                size_t hash{0};
+
+                bool operator==(const key_t& other) const {
+                    return hash == other.hash && words == other.words;
+                }
+
+                /// A hash function for containers that just returns the precomputed hash
+                struct Hash {
+                    size_t operator()(const key_t& key) const {
+                        return key.hash;
+                    }
+                };
+            };
+
+            key_t key() const {
+                key_t key;
+
+                switch (sock.sa_family) {
+                    case AF_INET:
+                        // The first words are 0 (ipv6) and after that is our address and then port
+                        std::memcpy(&key.words[6], &ipv4.sin_addr, sizeof(ipv4.sin_addr));
+                        key.words[8] = ipv4.sin_port;
+                        break;
+                    case AF_INET6:
+                        // IPv6 address then port
+                        std::memcpy(key.words.data(), &ipv6.sin6_addr, sizeof(ipv6.sin6_addr));
+                        key.words[8] = ipv6.sin6_port;
+                        break;
+                    default: throw std::invalid_argument("Unknown address family");
+                }
+
+                // FNV-1a over the words, it's short and the lookups that use it are on the hot path
+                uint64_t hash = 0xcbf29ce484222325ULL;
+                for (const auto& w : key.words) {
+                    hash = (hash ^ w) * 0x100000001b3ULL;
+                }
+                key.hash = size_t(hash ^ (hash >> 32));
+
+                return key;
+            }
+
             std::pair<std::string, in_port_t> address() const {
                 std::array<char, std::max(INET_ADDRSTRLEN, INET6_ADDRSTRLEN)> c = {0};
                 switch (sock.sa_family) {
@@ -0,0 +1,249 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lz4.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace NUClear {
+namespace util {
+    namespace serialise {
+
+        namespace {
+
+            /// The shortest match that can be encoded
+            constexpr size_t MIN_MATCH = 4;
+            /// The last match has to start at least this many bytes before the end of the block
+            constexpr size_t MATCH_LIMIT = 12;
+            /// The last this many bytes of a block are always literals
+            constexpr size_t LAST_LITERALS = 5;
+            /// The furthest back a match can be
+            constexpr size_t MAX_DISTANCE = 65535;
+            /// How many bits of the hash are used to index the table of recent positions
+            constexpr int HASH_BITS = 12;
+            /// How quickly the search skips ahead through data that isn't matching
+            constexpr int SKIP_STRENGTH = 6;
+
+            /**
+             * Reads 4 bytes of the input to compare and hash, the byte order doesn't matter for either.
+             *
+             * @param p The bytes to read
+             *
+             * @return The 4 bytes as an integer
+             */
+            inline uint32_t read32(const uint8_t* p) {
+                uint32_t v = 0;
+                std::memcpy(&v, p, sizeof(v));
+                return v;
+            }
+
+            /**
+             * Hashes 4 bytes of input to find where they were last seen.
+             *
+             * @param v The 4 bytes to hash
+             *
+             * @return An index into the table of recent positions
+             */
+            inline uint32_t hash(const uint32_t& v) {
+                return (v * 2654435761U) >> (32 - HASH_BITS);
+            }
+
+            /**
+             * Writes a length that didn't fit in its 4 bits of the token, as a run of 255s and the remainder.
+             *
+             * @param out    Where to write the length, it is advanced past it
+             * @param length How much of the length is left after the 15 in the token
+             */
+            inline void write_length(uint8_t*& out, size_t length) {
+                for (; length >= 255; length -= 255) {
+                    *out++ = 255;
+                }
+                *out++ = uint8_t(length);
+            }
+
+            /**
+             * Reads a length that didn't fit in its 4 bits of the token.
+             *
+             * @param in     Where to read the length from, it is advanced past it
+             * @param end    The end of the input
+             * @param length The length to add to
+             *
+             * @return false if the input ended before the length did
+             */
+            inline bool read_length(const uint8_t*& in, const uint8_t* end, size_t& length) {
+                uint8_t b = 0;
+                do {
+                    if (in == end) {
+                        return false;
+                    }
+                    b = *in++;
+                    length += b;
+                } while (b == 255);
+                return true;
+            }
+
+        }  // namespace
+
+        size_t lz4_bound(const size_t& length) {
+            return length + length / 255 + 16;
+        }
+
+        size_t lz4_compress(const void* input, const size_t& length, void* output, const size_t& capacity) {
+            const auto* in = static_cast<const uint8_t*>(input);
+            auto* out      = static_cast<uint8_t*>(output);
+            auto* out_end  = out + capacity;
+
+            // Writes a sequence of literals and the match that follows them, or just literals if there is no match
+            auto sequence = [&](const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length) {
+                // Check it will fit, allowing for the longest the two lengths can take to write
+                const size_t most = 1 + literal_length / 255 + 1 + literal_length + 2 + match_length / 255 + 1;
+                if (size_t(out_end - out) < most) {
+                    return false;
+                }
+
+                uint8_t& token = *out++;
+                token          = uint8_t(std::min<size_t>(literal_length, 15) << 4);
+                if (literal_length >= 15) {
+                    write_length(out, literal_length - 15);
+                }
+                out = std::copy(literals, literals + literal_length, out);
+
+                if (match_length > 0) {
+                    *out++         = uint8_t(offset);
+                    *out++         = uint8_t(offset >> 8);
+                    const size_t m = match_length - MIN_MATCH;
+                    token |= uint8_t(std::min<size_t>(m, 15));
+                    if (m >= 15) {
+                        write_length(out, m - 15);
+                    }
+                }
+                return true;
+            };
+
+            size_t anchor = 0;
+
+            // Blocks too short to hold a match are all literals
+            if (length > MATCH_LIMIT) {
+                // Where 4 bytes with each hash were last seen, a stale entry is fine as every match is checked
+                std::vector<size_t> table(size_t(1) << HASH_BITS, 0);
+
+                const size_t last_match = length - MATCH_LIMIT;
+                const size_t match_end  = length - LAST_LITERALS;
+                size_t pos              = 0;
+                size_t misses           = size_t(1) << SKIP_STRENGTH;
+                while (pos <= last_match) {
+                    const uint32_t v      = read32(in + pos);
+                    size_t& slot          = table[hash(v)];
+                    const size_t previous = slot;
+                    slot                  = pos;
+
+                    if (previous < pos && pos - previous <= MAX_DISTANCE && read32(in + previous) == v) {
+                        size_t match = MIN_MATCH;
+                        while (pos + match < match_end && in[previous + match] == in[pos + match]) {
+                            ++match;
+                        }
+                        if (!sequence(in + anchor, pos - anchor, pos - previous, match)) {
+                            return 0;
+                        }
+                        pos += match;
+                        anchor = pos;
+                        misses = size_t(1) << SKIP_STRENGTH;
+                    }
+                    else {
+                        // The longer we go without a match the further we skip, so data that doesn't compress is
+                        // quick to get through
+                        pos += misses++ >> SKIP_STRENGTH;
+                    }
+                }
+            }
+
+            // Everything left over is written as literals
+            if (!sequence(in + anchor, length - anchor, 0, 0)) {
+                return 0;
+            }
+            return size_t(out - static_cast<uint8_t*>(output));
+        }
+
+        bool lz4_decompress(const void* input, const size_t& length, void* output, const size_t& output_length) {
+            const auto* in      = static_cast<const uint8_t*>(input);
+            const auto* in_end  = in + length;
+            auto* const start   = static_cast<uint8_t*>(output);
+            auto* out           = start;
+            auto* const out_end = start + output_length;
+
+            while (in < in_end) {
+                const uint8_t token = *in++;
+
+                // The literals
+                size_t literal_length = token >> 4;
+                if (literal_length == 15 && !read_length(in, in_end, literal_length)) {
+                    return false;
+                }
+                if (literal_length > size_t(in_end - in) || literal_length > size_t(out_end - out)) {
+                    return false;
+                }
+                out = std::copy(in, in + literal_length, out);
+                in += literal_length;
+
+                // The last sequence is only literals
+                if (in == in_end) {
+                    break;
+                }
+
+                // The match
+                if (in_end - in < 2) {
+                    return false;
+                }
+                const size_t offset = size_t(in[0]) | (size_t(in[1]) << 8);
+                in += 2;
+                size_t match_length = token & 0x0F;
+                if (match_length == 15 && !read_length(in, in_end, match_length)) {
+                    return false;
+                }
+                match_length += MIN_MATCH;
+                if (offset == 0 || offset > size_t(out - start) || match_length > size_t(out_end - out)) {
+                    return false;
+                }
+
+                // Matches can overlap what they are writing, which repeats the bytes between them
+                const uint8_t* from = out - offset;
+                if (offset >= match_length) {
+                    std::memcpy(out, from, match_length);
+                    out += match_length;
+                }
+                else {
+                    for (size_t i = 0; i < match_length; ++i) {
+                        *out++ = *from++;
+                    }
+                }
+            }
+
+            return out == out_end;
+        }
+
+    }  // namespace serialise
+}  // namespace util
+}  // namespace NUClear
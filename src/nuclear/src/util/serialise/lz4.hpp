@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NUCLEAR_UTIL_SERIALISE_LZ4_HPP
+#define NUCLEAR_UTIL_SERIALISE_LZ4_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace NUClear {
+namespace util {
+    namespace serialise {
+
+        /**
+         * The most bytes that lz4_compress can produce for an input of the given length.
+         *
+         * @param length Length of the input data in bytes.
+         *
+         * @return The number of bytes of output that is always enough to compress the input.
+         */
+        size_t lz4_bound(const size_t& length);
+
+        /**
+         * Compresses data into a single LZ4 block.
+         *
+         * The output is a raw LZ4 block, without the frame that the lz4 command line tool wraps around it, so it can
+         * be read by any LZ4 block decoder as long as the uncompressed length is passed along with it.
+         *
+         * @param input    Pointer to the input data.
+         * @param length   Length of the input data in bytes.
+         * @param output   Pointer to the buffer to write the compressed data to.
+         * @param capacity Size of the output buffer in bytes.
+         *
+         * @return The number of bytes written to the output, or 0 if the compressed data does not fit in it.
+         *         Giving a capacity smaller than the input is a quick way to give up on data that doesn't compress.
+         */
+        size_t lz4_compress(const void* input, const size_t& length, void* output, const size_t& capacity);
+
+        /**
+         * Decompresses a single LZ4 block.
+         *
+         * The input is checked as it is read, so corrupt or malicious data can never read or write out of bounds.
+         *
+         * @param input         Pointer to the compressed data.
+         * @param length        Length of the compressed data in bytes.
+         * @param output        Pointer to the buffer to write the decompressed data to.
+         * @param output_length The exact number of bytes the data decompresses to.
+         *
+         * @return true if the block was valid and decompressed to exactly output_length bytes.
+         */
+        bool lz4_decompress(const void* input, const size_t& length, void* output, const size_t& output_length);
+
+    }  // namespace serialise
+}  // namespace util
+}  // namespace NUClear
+
+#endif  // NUCLEAR_UTIL_SERIALISE_LZ4_HPP
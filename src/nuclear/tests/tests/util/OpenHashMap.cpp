@@ -0,0 +1,209 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "util/OpenHashMap.hpp"
+
+#include <array>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util/network/sock_t.hpp"
+
+namespace {
+
+using NUClear::util::OpenHashMap;
+using NUClear::util::network::sock_t;
+
+/// Make a unique ipv4 address and port for the nth peer
+sock_t make_peer(const uint32_t& n) {
+    sock_t address{};
+    address.ipv4.sin_family      = AF_INET;
+    address.ipv4.sin_addr.s_addr = htonl(0x0A000000 | n);
+    address.ipv4.sin_port        = htons(uint16_t(7447 + (n % 16)));
+    return address;
+}
+
+/// A hash that sends every key to the same slot so everything collides
+struct CollidingHash {
+    size_t operator()(const int& /*key*/) const {
+        return 3;
+    }
+};
+
+}  // namespace
+
+SCENARIO("OpenHashMap behaves like a map", "[util][OpenHashMap]") {
+
+    GIVEN("An empty map") {
+        OpenHashMap<std::string, int> map;
+
+        THEN("It has nothing in it") {
+            CHECK(map.empty());
+            CHECK(map.find("a") == nullptr);
+            CHECK_FALSE(map.erase("a"));
+        }
+
+        WHEN("Many entries are inserted") {
+            for (int i = 0; i < 1000; ++i) {
+                map[std::to_string(i)] = i;
+            }
+
+            THEN("Every entry can be found") {
+                REQUIRE(map.size() == 1000);
+                for (int i = 0; i < 1000; ++i) {
+                    REQUIRE(map.find(std::to_string(i)) != nullptr);
+                    CHECK(*map.find(std::to_string(i)) == i);
+                }
+                CHECK(map.find("1000") == nullptr);
+            }
+
+            AND_WHEN("Half of them are erased") {
+                for (int i = 0; i < 1000; i += 2) {
+                    REQUIRE(map.erase(std::to_string(i)));
+                }
+
+                THEN("Only the other half can be found") {
+                    CHECK(map.size() == 500);
+                    for (int i = 0; i < 1000; ++i) {
+                        CHECK((map.find(std::to_string(i)) != nullptr) == (i % 2 == 1));
+                    }
+                }
+            }
+
+            AND_WHEN("The map is cleared") {
+                map.clear();
+
+                THEN("It is empty") {
+                    CHECK(map.empty());
+                    CHECK(map.find("1") == nullptr);
+                }
+            }
+        }
+    }
+
+    GIVEN("A map where every key has the same hash") {
+        OpenHashMap<int, int, CollidingHash> map;
+        for (int i = 0; i < 10; ++i) {
+            map[i] = i * 10;
+        }
+
+        WHEN("An entry in the middle of the run is erased") {
+            const int erased = GENERATE(0, 4, 9);
+            REQUIRE(map.erase(erased));
+
+            THEN("The entries after it can still be found") {
+                for (int i = 0; i < 10; ++i) {
+                    if (i == erased) {
+                        CHECK(map.find(i) == nullptr);
+                    }
+                    else {
+                        REQUIRE(map.find(i) != nullptr);
+                        CHECK(*map.find(i) == i * 10);
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("Socket address keys") {
+        OpenHashMap<sock_t::key_t, int, sock_t::key_t::Hash> map;
+        for (uint32_t i = 0; i < 100; ++i) {
+            map[make_peer(i).key()] = int(i);
+        }
+
+        THEN("Each address finds its own entry") {
+            for (uint32_t i = 0; i < 100; ++i) {
+                REQUIRE(map.find(make_peer(i).key()) != nullptr);
+                CHECK(*map.find(make_peer(i).key()) == int(i));
+            }
+            CHECK(map.find(make_peer(100).key()) == nullptr);
+        }
+    }
+}
+
+// Compares the peer lookups done for every datagram against the std::map/std::multimap they replaced
+// Run with the [benchmark] tag as it is hidden by default
+TEST_CASE("Peer lookup tables", "[.][benchmark][util][OpenHashMap]") {
+
+    const uint32_t peers = GENERATE(10, 100, 1000);
+
+    std::vector<sock_t> addresses;
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < peers; ++i) {
+        addresses.push_back(make_peer(i));
+        names.push_back("peer_" + std::to_string(i));
+    }
+
+    std::map<std::array<uint16_t, 9>, std::shared_ptr<int>> udp_map;
+    std::multimap<std::string, std::shared_ptr<int>, std::less<>> name_map;
+    OpenHashMap<sock_t::key_t, std::shared_ptr<int>, sock_t::key_t::Hash> udp_table;
+    OpenHashMap<std::string, std::vector<std::shared_ptr<int>>> name_table;
+    for (uint32_t i = 0; i < peers; ++i) {
+        auto target = std::make_shared<int>(int(i));
+        udp_map.emplace(addresses[i].key().words, target);
+        name_map.emplace(names[i], target);
+        udp_table[addresses[i].key()] = target;
+        name_table[names[i]].push_back(target);
+    }
+
+    BENCHMARK("std::map address lookup with " + std::to_string(peers) + " peers") {
+        size_t found = 0;
+        for (const auto& address : addresses) {
+            found += udp_map.find(address.key().words) != udp_map.end() ? 1 : 0;
+        }
+        return found;
+    };
+
+    BENCHMARK("OpenHashMap address lookup with " + std::to_string(peers) + " peers") {
+        size_t found = 0;
+        for (const auto& address : addresses) {
+            found += udp_table.find(address.key()) != nullptr ? 1 : 0;
+        }
+        return found;
+    };
+
+    BENCHMARK("std::multimap name lookup with " + std::to_string(peers) + " peers") {
+        size_t found = 0;
+        for (const auto& name : names) {
+            auto range = name_map.equal_range(name);
+            found += size_t(std::distance(range.first, range.second));
+        }
+        return found;
+    };
+
+    BENCHMARK("OpenHashMap name lookup with " + std::to_string(peers) + " peers") {
+        size_t found = 0;
+        for (const auto& name : names) {
+            const auto* targets = name_table.find(name);
+            found += targets != nullptr ? targets->size() : 0;
+        }
+        return found;
+    };
+}
@@ -0,0 +1,101 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "util/network/InterestFilter.hpp"
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using NUClear::util::network::InterestFilter;
+
+SCENARIO("InterestFilter remembers which type hashes were inserted", "[util][network][InterestFilter]") {
+
+    GIVEN("An empty filter") {
+        InterestFilter<256> filter;
+
+        THEN("It contains nothing") {
+            CHECK_FALSE(filter.contains(0));
+            CHECK_FALSE(filter.contains(0x0123456789ABCDEF));
+            CHECK_FALSE(filter.contains(~uint64_t(0)));
+        }
+
+        WHEN("It is filled") {
+            filter.fill();
+
+            THEN("It contains everything") {
+                CHECK(filter.contains(0));
+                CHECK(filter.contains(0x0123456789ABCDEF));
+                CHECK(filter.contains(~uint64_t(0)));
+            }
+        }
+    }
+
+    GIVEN("A filter with a hundred random hashes inserted") {
+        InterestFilter<256> filter;
+        std::mt19937_64 rng(42);
+        std::vector<uint64_t> inserted;
+        for (int i = 0; i < 100; ++i) {
+            inserted.push_back(rng());
+            filter.insert(inserted.back());
+        }
+
+        THEN("It contains every one of them") {
+            for (const auto& hash : inserted) {
+                CHECK(filter.contains(hash));
+            }
+        }
+
+        THEN("It rarely contains hashes that were not inserted") {
+            int false_positives = 0;
+            for (int i = 0; i < 10000; ++i) {
+                false_positives += filter.contains(rng()) ? 1 : 0;
+            }
+            CHECK(false_positives < 100);
+        }
+
+        WHEN("It is cleared") {
+            filter.clear();
+
+            THEN("It contains none of them") {
+                for (const auto& hash : inserted) {
+                    CHECK_FALSE(filter.contains(hash));
+                }
+            }
+        }
+    }
+
+    GIVEN("A hash inserted into a filter") {
+        InterestFilter<8> filter;
+        filter.insert(0x0003000200010000);
+
+        THEN("Each 16 bit quarter of the hash sets its own bit, as peers expect") {
+            const std::array<uint8_t, 8> expected = {0x0F, 0, 0, 0, 0, 0, 0, 0};
+            for (size_t i = 0; i < filter.size(); ++i) {
+                CHECK(filter.data()[i] == expected[i]);
+            }
+        }
+    }
+}
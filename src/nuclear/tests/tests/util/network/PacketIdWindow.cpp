@@ -0,0 +1,151 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "util/network/PacketIdWindow.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <cstdint>
+
+using NUClear::util::network::PacketIdWindow;
+
+SCENARIO("PacketIdWindow finds duplicate packet ids", "[util][network][PacketIdWindow]") {
+
+    GIVEN("An empty window") {
+        PacketIdWindow<uint16_t, 256> window;
+
+        THEN("Nothing has been seen") {
+            CHECK_FALSE(window.contains(0));
+            CHECK_FALSE(window.contains(1));
+            CHECK_FALSE(window.contains(65535));
+        }
+
+        WHEN("Ids arrive out of order") {
+            window.insert(10);
+            window.insert(12);
+            window.insert(11);
+            window.insert(5);
+
+            THEN("Only those ids have been seen") {
+                for (int id = 0; id < 20; ++id) {
+                    CHECK(window.contains(uint16_t(id)) == (id == 5 || id == 10 || id == 11 || id == 12));
+                }
+            }
+
+            AND_WHEN("The window is cleared") {
+                window.clear();
+
+                THEN("Nothing has been seen") {
+                    CHECK_FALSE(window.contains(10));
+                    CHECK_FALSE(window.contains(12));
+                }
+            }
+        }
+    }
+
+    GIVEN("A window that has seen a run of ids") {
+        PacketIdWindow<uint16_t, 256> window;
+        const uint16_t start = GENERATE(uint16_t(1), uint16_t(65400));
+        for (int i = 0; i < 200; ++i) {
+            window.insert(uint16_t(start + i));
+        }
+
+        THEN("They have all been seen, across wrap around too") {
+            for (int i = 0; i < 200; ++i) {
+                CHECK(window.contains(uint16_t(start + i)));
+            }
+            CHECK_FALSE(window.contains(uint16_t(start + 200)));
+            CHECK_FALSE(window.contains(uint16_t(start - 1)));
+        }
+
+        WHEN("The window slides past the oldest of them") {
+            window.insert(uint16_t(start + 300));
+
+            THEN("The ids that fell out are unseen and the rest are still seen") {
+                for (int i = 0; i < 200; ++i) {
+                    CHECK(window.contains(uint16_t(start + i)) == (i > 300 - 256));
+                }
+                CHECK(window.contains(uint16_t(start + 300)));
+            }
+
+            AND_WHEN("An id that fell out arrives again") {
+                window.insert(uint16_t(start));
+
+                THEN("It isn't recorded as it can't be told apart from a newer id") {
+                    CHECK_FALSE(window.contains(uint16_t(start)));
+                }
+            }
+        }
+
+        WHEN("The ids wrap all the way around to the start again") {
+            for (int i = 200; i < 65536; i += 100) {
+                window.insert(uint16_t(start + i));
+            }
+
+            THEN("The old ids are not mistaken for the new ones") {
+                for (int i = 0; i < 36; ++i) {
+                    CHECK_FALSE(window.contains(uint16_t(start + i)));
+                }
+            }
+        }
+
+        WHEN("An id jumps far ahead") {
+            window.insert(uint16_t(start + 30000));
+
+            THEN("Everything before it is forgotten") {
+                for (int i = 0; i < 200; ++i) {
+                    CHECK_FALSE(window.contains(uint16_t(start + i)));
+                }
+                CHECK(window.contains(uint16_t(start + 30000)));
+            }
+        }
+    }
+
+    GIVEN("A window of 32 bit ids that has seen a run of ids across a 16 bit boundary") {
+        PacketIdWindow<uint32_t, 256> window;
+        const uint32_t start = GENERATE(uint32_t(0xFFA0), uint32_t(0xFFFFFFA0));
+        for (uint32_t i = 0; i < 200; ++i) {
+            window.insert(start + i);
+        }
+
+        THEN("They have all been seen, and ids that only match in their lower 16 bits have not") {
+            for (uint32_t i = 0; i < 200; ++i) {
+                CHECK(window.contains(start + i));
+                CHECK_FALSE(window.contains(start + i + 0x10000));
+                CHECK_FALSE(window.contains(start + i - 0x10000));
+            }
+        }
+
+        WHEN("A late retransmission arrives with an id from a whole 16 bit cycle before") {
+            const uint32_t late = start + 210 - 0x10000;
+            window.insert(late);
+
+            THEN("It isn't mistaken for a new id and the window stays where it was") {
+                CHECK_FALSE(window.contains(late));
+                for (uint32_t i = 0; i < 200; ++i) {
+                    CHECK(window.contains(start + i));
+                }
+                CHECK_FALSE(window.contains(start + 210));
+            }
+        }
+    }
+}
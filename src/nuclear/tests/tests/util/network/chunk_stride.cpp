@@ -0,0 +1,82 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "util/network/chunk_stride.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <cstdint>
+
+using NUClear::util::network::chunk_stride;
+
+SCENARIO("chunk_stride finds the size of the chunks of a packet", "[util][network][chunk_stride]") {
+
+    GIVEN("A packet split into chunks of 1000 bytes with a shorter last chunk") {
+        const uint64_t last_length = GENERATE(uint64_t(0), uint64_t(1), uint64_t(999));
+        const uint32_t count       = GENERATE(uint32_t(2), uint32_t(100), uint32_t(70000));
+        const uint64_t length      = uint64_t(count - 1) * 1000 + last_length;
+
+        THEN("Any chunk but the last gives the stride") {
+            CHECK(chunk_stride(length, count, false, 1000) == 1000);
+        }
+
+        THEN("The last chunk gives the stride") {
+            CHECK(chunk_stride(length, count, true, size_t(last_length)) == 1000);
+        }
+
+        THEN("A chunk too small or large to make up the length with that many chunks is rejected") {
+            CHECK(chunk_stride(length, count, false, 400) == 0);
+            CHECK(chunk_stride(length, count, false, 2100) == 0);
+            CHECK(chunk_stride(length, count, true, size_t(last_length) + 1000) == 0);
+        }
+
+        THEN("A chunk that claims too many or too few chunks is rejected") {
+            CHECK(chunk_stride(length, count + 1, false, 1000) == 0);
+            CHECK(chunk_stride(length, count - 1, false, 1000) == 0);
+        }
+    }
+
+    GIVEN("A chunk that is as long as the whole packet is meant to be") {
+        THEN("It is rejected as the last chunk must be shorter than the rest") {
+            CHECK(chunk_stride(2000, 2, true, 1000) == 0);
+            CHECK(chunk_stride(2000, 2, false, 1000) == 0);
+        }
+    }
+
+    GIVEN("A chunk that claims a length far larger than its chunks could make up") {
+        THEN("It is rejected") {
+            CHECK(chunk_stride(uint64_t(1) << 62, 2, false, 1000) == 0);
+            CHECK(chunk_stride(uint64_t(1) << 62, 0xFFFFFFFF, false, 1000) == 0);
+            CHECK(chunk_stride(uint64_t(1) << 62, 0xFFFFFFFF, true, 1000) == 0);
+        }
+    }
+
+    GIVEN("A chunk with empty chunks or too few chunks") {
+        THEN("It is rejected") {
+            CHECK(chunk_stride(0, 2, false, 0) == 0);
+            CHECK(chunk_stride(0, 2, true, 0) == 0);
+            CHECK(chunk_stride(1000, 1, true, 1000) == 0);
+            CHECK(chunk_stride(1000, 0, false, 1000) == 0);
+        }
+    }
+}
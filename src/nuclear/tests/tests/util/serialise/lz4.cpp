@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2026 NUClear Contributors
+ *
+ * This file is part of the NUClear codebase.
+ * See https://github.com/Fastcode/NUClear for further info.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "util/serialise/lz4.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+using NUClear::util::serialise::lz4_bound;
+using NUClear::util::serialise::lz4_compress;
+using NUClear::util::serialise::lz4_decompress;
+
+namespace {
+
+std::vector<uint8_t> make_input(const std::string& kind) {
+    std::vector<uint8_t> data;
+    std::mt19937 rng(1234);
+    if (kind == "short") {
+        const std::string s = "abcabcabcab";
+        data.assign(s.begin(), s.end());
+    }
+    else if (kind == "run") {
+        data.assign(100000, 'a');
+    }
+    else if (kind == "text") {
+        for (int i = 0; i < 5000; ++i) {
+            const std::string s = "{\"id\":" + std::to_string(i) + ",\"name\":\"robot" + std::to_string(i % 7) + "\"}";
+            data.insert(data.end(), s.begin(), s.end());
+        }
+    }
+    else if (kind == "random") {
+        for (int i = 0; i < 100000; ++i) {
+            data.push_back(uint8_t(rng()));
+        }
+    }
+    else if (kind == "mixed") {
+        // Data that doesn't compress followed by data that does, so skipping ahead doesn't miss the second part
+        for (int i = 0; i < 200000; ++i) {
+            data.push_back(i < 100000 ? uint8_t(rng()) : uint8_t("NUClear"[i % 7]));
+        }
+    }
+    return data;
+}
+
+}  // namespace
+
+SCENARIO("lz4 blocks can be decompressed", "[util][serialise][lz4]") {
+
+    GIVEN("A block made by the reference lz4 tool") {
+        const std::string expected =
+            "The dog flew the rocket, the dog flew the rocket, the dog flew the rocket to the moon!";
+        const std::vector<uint8_t> block = {
+            0xf1, 0x09, 0x54, 0x68, 0x65, 0x20, 0x64, 0x6f, 0x67, 0x20, 0x66, 0x6c, 0x65, 0x77, 0x20, 0x74,
+            0x68, 0x65, 0x20, 0x72, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x2c, 0x0c, 0x00, 0x0f, 0x19, 0x00, 0x19,
+            0xd0, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x6f, 0x6e, 0x21};
+
+        WHEN("It is decompressed") {
+            std::vector<uint8_t> out(expected.size());
+            const bool ok = lz4_decompress(block.data(), block.size(), out.data(), out.size());
+
+            THEN("It matches the original text") {
+                REQUIRE(ok);
+                CHECK(std::string(out.begin(), out.end()) == expected);
+            }
+        }
+
+        WHEN("It is decompressed with the wrong length") {
+            std::vector<uint8_t> out(expected.size() + 1);
+
+            THEN("It fails") {
+                CHECK_FALSE(lz4_decompress(block.data(), block.size(), out.data(), out.size() - 2));
+                CHECK_FALSE(lz4_decompress(block.data(), block.size(), out.data(), out.size()));
+            }
+        }
+
+        WHEN("It is cut short or corrupted") {
+            std::vector<uint8_t> out(expected.size());
+            std::vector<uint8_t> bad_offset = block;
+            bad_offset[27]                  = 0xff;
+
+            THEN("It fails without reading or writing out of bounds") {
+                for (size_t length = 0; length < block.size(); ++length) {
+                    CHECK_FALSE(lz4_decompress(block.data(), length, out.data(), out.size()));
+                }
+                CHECK_FALSE(lz4_decompress(bad_offset.data(), bad_offset.size(), out.data(), out.size()));
+            }
+        }
+    }
+}
+
+SCENARIO("lz4 compressed data decompresses to the original", "[util][serialise][lz4]") {
+
+    GIVEN("Some data") {
+        const std::string kind          = GENERATE("empty", "short", "run", "text", "random", "mixed");
+        const std::vector<uint8_t> data = make_input(kind);
+
+        WHEN("It is compressed with room for the worst case") {
+            std::vector<uint8_t> compressed(lz4_bound(data.size()));
+            const size_t length = lz4_compress(data.data(), data.size(), compressed.data(), compressed.size());
+
+            THEN("It decompresses to the original data") {
+                INFO(kind);
+                REQUIRE(length > 0);
+                std::vector<uint8_t> out(data.size());
+                REQUIRE(lz4_decompress(compressed.data(), length, out.data(), out.size()));
+                CHECK(out == data);
+            }
+
+            THEN("Data that repeats itself is smaller") {
+                INFO(kind);
+                if (kind == "run" || kind == "text") {
+                    CHECK(length < data.size() / 2);
+                }
+                // Only the second half of the mixed data can be compressed
+                if (kind == "mixed") {
+                    CHECK(length < data.size() * 3 / 4);
+                }
+            }
+        }
+    }
+
+    GIVEN("Data that doesn't compress") {
+        const std::vector<uint8_t> data = make_input("random");
+
+        WHEN("It is compressed with less room than the data itself") {
+            std::vector<uint8_t> compressed(data.size() - 1);
+            const size_t length = lz4_compress(data.data(), data.size(), compressed.data(), compressed.size());
+
+            THEN("It gives up") {
+                CHECK(length == 0);
+            }
+        }
+    }
+}
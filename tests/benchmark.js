@@ -0,0 +1,57 @@
+// Measures how many system calls it takes to send a megabyte of reliable data between two peers, and how fast it
+// gets there with each congestion control mode, and how many acks come back for it.
+//
+// Without batching every datagram is its own sendmsg call, so "datagrams per MB" is the cost before batching and
+// "send calls per MB" is the cost after it. Run with `npm run benchmark -- [megabytes] [mtu]`.
+
+const { NUClearNet } = require('..');
+
+const megabytes = Number(process.argv[2] || 64);
+const mtu = Number(process.argv[3] || 1500);
+const messageSize = 1024 * 1024;
+
+function run(congestionControl) {
+  return new Promise((resolve) => {
+    const id = String(Math.random() * 100000000).slice(0, 7);
+    const sender = { name: `bench-send-${id}`, net: new NUClearNet() };
+    const receiver = { name: `bench-recv-${id}`, net: new NUClearNet() };
+
+    let received = 0;
+    let start;
+
+    receiver.net.on('benchmark', () => {
+      received++;
+      if (received === megabytes) {
+        const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+        const stats = sender.net.stats();
+
+        console.log(`sent ${megabytes} MB with an mtu of ${mtu} and '${congestionControl}' congestion control`);
+        console.log(`  goodput:                        ${(megabytes / seconds).toFixed(1)} MB/s`);
+        console.log(`  before (one call per datagram): ${(stats.datagramsSent / megabytes).toFixed(1)} syscalls/MB`);
+        console.log(`  after  (batched transmit):      ${(stats.sendCalls / megabytes).toFixed(1)} syscalls/MB`);
+        const acks = receiver.net.stats().acksSent;
+        console.log(`  acks received:                  ${(acks / megabytes).toFixed(1)} per MB`);
+
+        sender.net.destroy();
+        receiver.net.destroy();
+        resolve();
+      }
+    });
+
+    sender.net.on('nuclear_join', ({ name }) => {
+      if (name !== receiver.name) {
+        return;
+      }
+
+      const payload = Buffer.alloc(messageSize, 0xab);
+      start = process.hrtime.bigint();
+      for (let i = 0; i < megabytes; i++) {
+        sender.net.send({ type: 'benchmark', payload, target: receiver.name, reliable: true });
+      }
+    });
+
+    [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name, mtu, congestionControl }));
+  });
+}
+
+run('none').then(() => run('aimd'));
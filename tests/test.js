@@ -1,3 +1,4 @@
+const dgram = require('dgram');
 const { test } = require('uvu');
 const assert = require('uvu/assert');
 
@@ -22,6 +23,29 @@ function createPeers(count, setupState = (peer) => peer) {
   });
 }
 
+// A peer that only speaks version 2 of the protocol, announcing itself over a plain socket to the default group
+function createVersion2Peer() {
+  const name = `net-v2-${randomId()}`;
+  const socket = dgram.createSocket('udp4');
+  const announce = Buffer.concat([Buffer.from([0xe2, 0x98, 0xa2, 0x02, 0x01]), Buffer.from(name), Buffer.from([0])]);
+  let timer;
+
+  socket.bind(0, () => {
+    const send = () => socket.send(announce, 7447, '239.226.152.162');
+    send();
+    timer = setInterval(send, 100);
+  });
+
+  return {
+    name,
+    socket,
+    close() {
+      clearInterval(timer);
+      socket.close();
+    },
+  };
+}
+
 function asyncTest(testFn, { timeout = 1000 } = {}) {
   return new Promise((resolve, reject) => {
     let cleanUp;
@@ -85,6 +109,14 @@ test('NUClearNet instance throws if used after destroy()', () => {
     'NUClearNet.hash() throws if called after instance is destroyed',
   );
 
+  assert.throws(
+    () => {
+      net.stats();
+    },
+    /This network instance has been destroyed/,
+    'NUClearNet.stats() throws if called after instance is destroyed',
+  );
+
   assert.throws(
     () => {
       net.connect({});
@@ -108,6 +140,14 @@ test('NUClearNet instance throws if used after destroy()', () => {
     /This network instance has been destroyed/,
     'NUClearNet.send() throws if called after instance is destroyed',
   );
+
+  assert.throws(
+    () => {
+      net.sendBatch([]);
+    },
+    /This network instance has been destroyed/,
+    'NUClearNet.sendBatch() throws if called after instance is destroyed',
+  );
 });
 
 test('NUClearNet.hash()', () => {
@@ -121,6 +161,18 @@ test('NUClearNet.hash()', () => {
   net.destroy();
 });
 
+test('NUClearNet.type()', () => {
+  const net = new NUClearNet();
+
+  const type = net.type('nuclearnet');
+
+  assert.is(type.name, 'nuclearnet', 'Handle keeps the type name');
+  assert.is(String(type), 'nuclearnet', 'Handle converts to the type name');
+  assert.equal(net.hash(type.hash), net.hash('nuclearnet'), 'Handle hash matches the hash of the type name');
+
+  net.destroy();
+});
+
 test('NUClearNet.send() throws if used before connect()', () => {
   const net = new NUClearNet();
 
@@ -561,4 +613,876 @@ test('NUClearNet can send and receive unreliable untargeted messages', async ()
   );
 });
 
+test('NUClearNet delivers every packet when packets are batched', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver, with the receiver limiting the batch size it is delivered
+  //   - When the receiver joins the sender, send many reliable messages back to back so they are batched together
+  //   - End successfully when the receiver has got every message
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done) => {
+      const [sender, receiver] = createPeers(2);
+      const count = 50;
+      const received = new Set();
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          for (let i = 0; i < count; i++) {
+            sender.net.send({
+              target: peer.name,
+              reliable: true,
+              type: 'batched-message',
+              payload: Buffer.from(`message ${i}`),
+            });
+          }
+        }
+      });
+
+      receiver.net.on('batched-message', (packet) => {
+        received.add(packet.payload.toString('utf-8'));
+
+        if (received.size === count) {
+          cleanUp();
+          done();
+        }
+      });
+
+      sender.net.connect({ name: sender.name });
+      receiver.net.connect({ name: receiver.name, maxBatchSize: 8 });
+
+      return cleanUp;
+    },
+    { timeout: 5000 },
+  );
+});
+
+test('NUClearNet can send and receive when running on a network thread', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver that both run their network on a native thread
+  //   - When the receiver joins the sender, send it a reliable message
+  //   - End successfully when the receiver gets the message
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done) => {
+      const [sender, receiver] = createPeers(2);
+      const payload = Buffer.from('oh hai from another thread');
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net.send({
+            target: peer.name,
+            reliable: true,
+            type: 'threaded-message',
+            payload,
+          });
+        }
+      });
+
+      receiver.net.on('threaded-message', (packet) => {
+        if (packet.peer.name === sender.name && packet.payload.compare(payload) === 0) {
+          cleanUp();
+          done();
+        }
+      });
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name, networkThread: true }));
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+test('NUClearNet only delivers packets for types that are listened to', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver, with the receiver listening to a single type
+  //   - When the receiver joins the sender, send it a message of an unwanted type followed by a wanted one
+  //   - End successfully when the receiver gets the wanted message and nothing else was delivered to javascript
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net.send({ target: peer.name, reliable: true, type: 'unwanted-message', payload: Buffer.from('no') });
+          sender.net.send({ target: peer.name, reliable: true, type: 'wanted-message', payload: Buffer.from('yes') });
+        }
+      });
+
+      receiver.net.on('wanted-message', (packet) => {
+        assert.is(packet.type, 'wanted-message');
+
+        const { packetsDelivered } = receiver.net.stats();
+        cleanUp();
+
+        if (packetsDelivered === 1) {
+          done();
+        } else {
+          fail(`expected 1 packet to be delivered, got ${packetsDelivered}`);
+        }
+      });
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name }));
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+test('NUClearNet can send and receive using type handles', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver, which each make a handle for the message type
+  //   - The receiver listens using its handle, and when the receiver joins the sender sends using its handle
+  //   - End successfully when the receiver gets the message with the type name set
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done) => {
+      const [sender, receiver] = createPeers(2);
+      const payload = Buffer.from('oh hai from a handle');
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      const sendType = sender.net.type('handle-message');
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net.send({ target: peer.name, reliable: true, type: sendType, payload });
+        }
+      });
+
+      receiver.net.on(receiver.net.type('handle-message'), (packet) => {
+        if (packet.type === 'handle-message' && packet.payload.compare(payload) === 0) {
+          cleanUp();
+          done();
+        }
+      });
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name }));
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+test('NUClearNet can send a batch of messages', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver
+  //   - When the receiver joins the sender, send a batch of messages to it with one invalid message in the middle
+  //   - Check that only the invalid message reports an error
+  //   - End successfully when the receiver has got every valid message
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+      const count = 10;
+      const received = new Set();
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          const messages = [];
+          for (let i = 0; i < count; i++) {
+            messages.push({ target: peer.name, reliable: true, type: 'batch-message', payload: Buffer.from(`${i}`) });
+          }
+          messages.splice(5, 0, { target: peer.name, type: 'batch-message', payload: 'not a buffer' });
+
+          const errors = sender.net.sendBatch(messages);
+          const failed = errors.map((error, i) => (error ? i : -1)).filter((i) => i >= 0);
+          if (failed.length !== 1 || failed[0] !== 5) {
+            cleanUp();
+            fail(`expected only message 5 to fail, got [${failed}]`);
+          }
+        }
+      });
+
+      receiver.net.on('batch-message', (packet) => {
+        received.add(packet.payload.toString('utf-8'));
+
+        if (received.size === count) {
+          cleanUp();
+          done();
+        }
+      });
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name }));
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+test('NUClearNet resolves acknowledged sends once the target has the message', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver
+  //   - When the receiver joins the sender, send it a reliable message asking for acknowledgement
+  //   - End successfully when the promise resolves with the receiver's latency
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net
+            .send({
+              target: peer.name,
+              reliable: true,
+              acknowledge: true,
+              timeout: 500,
+              type: 'acknowledged-message',
+              payload: Buffer.from('did you get this?'),
+            })
+            .then((acks) => {
+              cleanUp();
+              if (acks.length === 1 && acks[0].name === receiver.name && acks[0].latency >= 0) {
+                done();
+              } else {
+                fail(`unexpected acknowledgements ${JSON.stringify(acks)}`);
+              }
+            }, fail);
+        }
+      });
+
+      receiver.net.on('acknowledged-message', () => {});
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name }));
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+['aimd', 'none'].forEach((congestionControl) => {
+  test(`NUClearNet delivers large reliable messages with ${congestionControl} congestion control`, async () => {
+    // Test set up:
+    //   - Create a sender using the congestion control and a receiver
+    //   - When the receiver joins the sender, send it a message of many chunks asking for acknowledgement
+    //   - End successfully when the receiver has the whole message and the promise resolves with its ack
+    //   - Automatically end with failure if the above doesn't happen before the timeout
+    await asyncTest(
+      (done, fail) => {
+        const [sender, receiver] = createPeers(2);
+        const payload = Buffer.alloc(1024 * 1024);
+        for (let i = 0; i < payload.length; i++) {
+          payload[i] = (i * 7919) % 251;
+        }
+
+        let received = false;
+        let acknowledged = false;
+
+        function cleanUp() {
+          [sender, receiver].forEach((peer) => peer.net.destroy());
+        }
+
+        function check() {
+          if (received && acknowledged) {
+            cleanUp();
+            done();
+          }
+        }
+
+        sender.net.on('nuclear_join', (peer) => {
+          if (peer.name === receiver.name) {
+            sender.net
+              .send({ target: peer.name, reliable: true, acknowledge: true, type: 'large-message', payload })
+              .then((acks) => {
+                if (acks.length === 1 && acks[0].name === receiver.name) {
+                  acknowledged = true;
+                  check();
+                } else {
+                  cleanUp();
+                  fail(`unexpected acknowledgements ${JSON.stringify(acks)}`);
+                }
+              }, fail);
+          }
+        });
+
+        receiver.net.on('large-message', (packet) => {
+          if (packet.payload.equals(payload)) {
+            received = true;
+            check();
+          } else {
+            cleanUp();
+            fail('the message was not the same when it arrived');
+          }
+        });
+
+        sender.net.connect({ name: sender.name, congestionControl });
+        receiver.net.connect({ name: receiver.name });
+
+        return cleanUp;
+      },
+      { timeout: 3000 },
+    );
+  });
+});
+
+test('NUClearNet acknowledges many chunks of a reliable message with each ack', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver
+  //   - When the receiver joins the sender, send it a reliable message of a few hundred chunks
+  //   - End successfully when the receiver has the message and sent fewer acks than there were chunks
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+      const payload = Buffer.alloc(512 * 1024, 'ack');
+
+      // Every chunk is smaller than the mtu, so there are more chunks than this
+      const chunks = Math.floor(payload.length / 1500);
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net.send({ target: peer.name, reliable: true, type: 'chunked-message', payload });
+        }
+      });
+
+      receiver.net.on('chunked-message', (packet) => {
+        const { acksSent } = receiver.net.stats();
+        cleanUp();
+
+        if (!packet.payload.equals(payload)) {
+          fail('the message was not the same when it arrived');
+        } else if (acksSent === 0 || acksSent >= chunks) {
+          fail(`expected between 1 and ${chunks} acks to be sent, got ${acksSent}`);
+        } else {
+          done();
+        }
+      });
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name }));
+
+      return cleanUp;
+    },
+    { timeout: 2000 },
+  );
+});
+
+test('NUClearNet can stream a message to a target as it is written', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver that receives the type as a stream
+  //   - When the receiver joins the sender, write a few megabytes to a stream, waiting when it pushes back
+  //   - End successfully when the receiver has read every byte in order and the sender's stream has finished
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+      const length = 4 * 1024 * 1024;
+      const piece = Buffer.alloc(64 * 1024);
+      let read = false;
+      let finished = false;
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      function check() {
+        if (read && finished) {
+          cleanUp();
+          done();
+        }
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          const stream = sender.net.sendStream({ target: peer.name, type: 'streamed-message', length });
+          stream.on('error', (err) => fail(err.message));
+          stream.on('finish', () => {
+            finished = true;
+            check();
+          });
+
+          let written = 0;
+          (function write() {
+            while (written < length) {
+              for (let i = 0; i < piece.length; i++) {
+                piece[i] = (written + i) % 251;
+              }
+              written += piece.length;
+              if (!stream.write(Buffer.from(piece))) {
+                stream.once('drain', write);
+                return;
+              }
+            }
+            stream.end();
+          })();
+        }
+      });
+
+      receiver.net.onStream('streamed-message', (packet) => {
+        let offset = 0;
+        packet.payload.on('data', (data) => {
+          for (let i = 0; i < data.length; i++) {
+            if (data[i] !== (offset + i) % 251) {
+              fail(`byte ${offset + i} of the stream was wrong`);
+              return;
+            }
+          }
+          offset += data.length;
+        });
+        packet.payload.on('end', () => {
+          if (offset === length) {
+            read = true;
+            check();
+          } else {
+            fail(`read ${offset} of the ${length} bytes in the stream`);
+          }
+        });
+      });
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name }));
+
+      return cleanUp;
+    },
+    { timeout: 5000 },
+  );
+});
+
+test('NUClearNet compresses large messages for peers that can decompress them', async () => {
+  // Test set up:
+  //   - Create a sender that compresses messages over a kilobyte, and a receiver
+  //   - When the receiver joins the sender, send it a large message that compresses well
+  //   - End successfully when the receiver gets the original message and the sender counted it as compressed
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+      const payload = Buffer.from('all work and no play makes jack a dull boy. '.repeat(10000));
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net.send({ target: peer.name, reliable: true, type: 'compressed-message', payload });
+        }
+      });
+
+      receiver.net.on('compressed-message', (packet) => {
+        const { packetsCompressed, compressionInputBytes, compressionOutputBytes } = sender.net.stats();
+        cleanUp();
+
+        if (!packet.payload.equals(payload)) {
+          fail('the message was not the same once it was decompressed');
+        } else if (packetsCompressed !== 1 || compressionOutputBytes >= compressionInputBytes) {
+          fail(`expected 1 packet to be compressed, got ${packetsCompressed}`);
+        } else {
+          done();
+        }
+      });
+
+      sender.net.connect({ name: sender.name, compressionThreshold: 1024 });
+      receiver.net.connect({ name: receiver.name });
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+test('NUClearNet sends unreliable messages over type groups to the peers listening to them', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver that both spread messages over 8 type groups
+  //   - When the receiver joins the sender, keep sending it unreliable messages to everyone
+  //   - End successfully when the receiver gets one of the messages
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done) => {
+      const [sender, receiver] = createPeers(2);
+      const payload = Buffer.from('grouped');
+      let interval;
+
+      function cleanUp() {
+        clearInterval(interval);
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          // Unreliable messages can be lost while the receiver is still joining its group, so keep sending
+          interval = setInterval(() => {
+            sender.net.send({ reliable: false, type: 'grouped-message', payload });
+          }, 20);
+        }
+      });
+
+      receiver.net.on('grouped-message', (packet) => {
+        if (packet.payload.equals(payload)) {
+          cleanUp();
+          done();
+        }
+      });
+
+      sender.net.connect({ name: sender.name, typeGroups: 8 });
+      receiver.net.connect({ name: receiver.name, typeGroups: 8 });
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+test('NUClearNet only sends messages to the peers that listen to their type', async () => {
+  // Test set up:
+  //   - Create a sender, a listener that listens to the type and a bystander that doesn't
+  //   - When both have joined the sender, send an acknowledged reliable message to everyone
+  //   - End successfully when only the listener acknowledges it and the sender skipped the bystander
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, listener, bystander] = createPeers(3);
+      const joined = new Set();
+
+      function cleanUp() {
+        [sender, listener, bystander].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        // Send once both of them have joined
+        if (peer.name !== listener.name && peer.name !== bystander.name) {
+          return;
+        }
+        joined.add(peer.name);
+        if (joined.size === 2) {
+          sender.net
+            .send({ reliable: true, acknowledge: true, type: 'interesting-message', payload: Buffer.from('hello') })
+            .then((acks) => {
+              const { peersSkipped } = sender.net.stats();
+              cleanUp();
+              if (acks.length !== 1 || acks[0].name !== listener.name) {
+                fail(`unexpected acknowledgements ${JSON.stringify(acks)}`);
+              } else if (peersSkipped < 1) {
+                fail('expected the bystander to be skipped');
+              } else {
+                done();
+              }
+            }, fail);
+        }
+      });
+
+      listener.net.on('interesting-message', () => {});
+      bystander.net.on('boring-message', () => {});
+
+      [sender, listener, bystander].forEach((peer) => peer.net.connect({ name: peer.name }));
+
+      return cleanUp;
+    },
+    { timeout: 1000 },
+  );
+});
+
+test('NUClearNet stops reading when the queue to JavaScript is full and blocking', async () => {
+  // Test set up:
+  //   - Create a sender, and a receiver that queues at most 4 packets, blocks when full and holds packets for a while
+  //   - When the receiver joins the sender, send it 20 reliable messages at once
+  //   - Fail if the receiver ever has more than 4 packets queued
+  //   - End successfully when the receiver gets all 20 messages
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+      const maxQueueSize = 4;
+      let received = 0;
+      let interval;
+
+      function cleanUp() {
+        clearInterval(interval);
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          for (let i = 0; i < 20; i++) {
+            sender.net.send({ target: peer.name, reliable: true, type: 'queued-message', payload: Buffer.from([i]) });
+          }
+        }
+      });
+
+      receiver.net.on('queued-message', () => {
+        received += 1;
+        if (received === 20) {
+          cleanUp();
+          done();
+        }
+      });
+
+      interval = setInterval(() => {
+        const { packetsQueued } = receiver.net.stats();
+        if (packetsQueued > maxQueueSize) {
+          cleanUp();
+          fail(`expected at most ${maxQueueSize} packets queued, got ${packetsQueued}`);
+        }
+      }, 1);
+
+      sender.net.connect({ name: sender.name });
+      receiver.net.connect({ name: receiver.name, maxQueueSize, queuePolicy: 'block', batchLatency: 20 });
+
+      return cleanUp;
+    },
+    { timeout: 2000 },
+  );
+});
+
+test('NUClearNet sends version 2 packets to peers that only announce version 2', async () => {
+  // Test set up:
+  //   - Create a NUClearNet and a peer that only speaks version 2 of the protocol
+  //   - When the peer joins, send it a reliable message of several chunks asking for acknowledgement
+  //   - The peer checks every chunk is a version 2 data packet, and acks the message once it has every chunk
+  //   - End successfully when the promise resolves and the peer put the message back together
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender] = createPeers(1);
+      const peer = createVersion2Peer();
+      const payload = Buffer.alloc(4000, 'version 2');
+      const chunks = new Map();
+
+      function cleanUp() {
+        sender.net.destroy();
+        peer.close();
+      }
+
+      peer.socket.on('message', (message, from) => {
+        // Only data packets and their retransmissions are checked
+        if (message.length < 20 || (message[4] !== 3 && message[4] !== 4)) {
+          return;
+        }
+        if (message[3] !== 0x02) {
+          cleanUp();
+          fail(`expected a version 2 data packet, got version ${message[3]}`);
+          return;
+        }
+
+        const packetId = message.readUInt16LE(5);
+        const packetNo = message.readUInt16LE(7);
+        const packetCount = message.readUInt16LE(9);
+        chunks.set(packetNo, message.subarray(20));
+
+        // Once every chunk is here acknowledge all of them at once
+        if (chunks.size === packetCount) {
+          const ack = Buffer.alloc(11 + Math.floor(packetCount / 8) + 1);
+          ack.set([0xe2, 0x98, 0xa2, 0x02, 0x05]);
+          ack.writeUInt16LE(packetId, 5);
+          ack.writeUInt16LE(packetNo, 7);
+          ack.writeUInt16LE(packetCount, 9);
+          for (let i = 0; i < packetCount; i++) {
+            ack[11 + (i >> 3)] |= 1 << (i & 7);
+          }
+          peer.socket.send(ack, from.port, from.address);
+        }
+      });
+
+      sender.net.on('nuclear_join', (joined) => {
+        if (joined.name === peer.name) {
+          sender.net
+            .send({ target: peer.name, reliable: true, acknowledge: true, type: 'version-2-message', payload })
+            .then(() => {
+              const received = Buffer.concat([...chunks.keys()].sort((a, b) => a - b).map((i) => chunks.get(i)));
+              cleanUp();
+
+              if (chunks.size < 2) {
+                fail(`expected the message to be sent in several chunks, got ${chunks.size}`);
+              } else if (!received.equals(payload)) {
+                fail('the peer did not get the same message that was sent');
+              } else {
+                done();
+              }
+            }, fail);
+        }
+      });
+
+      sender.net.connect({ name: sender.name });
+
+      return cleanUp;
+    },
+    { timeout: 2000 },
+  );
+});
+
+test('NUClearNet refuses to send messages of more than 65535 chunks to version 2 peers', async () => {
+  // Test set up:
+  //   - Create a NUClearNet with a small mtu and a peer that only speaks version 2 of the protocol
+  //   - When the peer joins, send it a message that needs more chunks than version 2 can count
+  //   - End successfully when the send throws saying the peer only understands version 2
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender] = createPeers(1);
+      const peer = createVersion2Peer();
+
+      function cleanUp() {
+        sender.net.destroy();
+        peer.close();
+      }
+
+      sender.net.on('nuclear_join', (joined) => {
+        if (joined.name === peer.name) {
+          try {
+            sender.net.send({
+              target: peer.name,
+              reliable: true,
+              type: 'too-many-chunks',
+              payload: Buffer.alloc(65536 * 200),
+            });
+            cleanUp();
+            fail('expected sending the message to throw');
+          } catch (error) {
+            cleanUp();
+            if (/version 2/.test(error.message)) {
+              done();
+            } else {
+              fail(`unexpected error ${error.message}`);
+            }
+          }
+        }
+      });
+
+      sender.net.connect({ name: sender.name, mtu: 200 });
+
+      return cleanUp;
+    },
+    { timeout: 2000 },
+  );
+});
+
+test('NUClearNet sends messages of more than 65535 chunks to version 3 peers', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver with a small mtu, which both speak version 3 of the protocol
+  //   - When the receiver joins the sender, send it a reliable message of 70000 chunks asking for acknowledgement
+  //   - End successfully when the receiver has the whole message and the promise resolves with its ack
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+      const payload = Buffer.alloc(70000 * 117);
+      for (let i = 0; i < payload.length; i++) {
+        payload[i] = (i * 7919) % 251;
+      }
+
+      let received = false;
+      let acknowledged = false;
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      function check() {
+        if (received && acknowledged) {
+          cleanUp();
+          done();
+        }
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net
+            .send({ target: peer.name, reliable: true, acknowledge: true, type: 'many-chunks', payload })
+            .then(() => {
+              acknowledged = true;
+              check();
+            }, fail);
+        }
+      });
+
+      receiver.net.on('many-chunks', (packet) => {
+        if (packet.payload.equals(payload)) {
+          received = true;
+          check();
+        } else {
+          cleanUp();
+          fail('the message was not the same when it arrived');
+        }
+      });
+
+      [sender, receiver].forEach((peer) => peer.net.connect({ name: peer.name, mtu: 200 }));
+
+      return cleanUp;
+    },
+    { timeout: 10000 },
+  );
+});
+
+test('NUClearNet drops messages larger than the largest it accepts', async () => {
+  // Test set up:
+  //   - Create a sender and a receiver that accepts messages of up to 64KB
+  //   - When the receiver joins the sender, send it a 256KB reliable message asking for acknowledgement
+  //   - End successfully when the send times out without the receiver getting the message
+  //   - Automatically end with failure if the above doesn't happen before the timeout
+  await asyncTest(
+    (done, fail) => {
+      const [sender, receiver] = createPeers(2);
+
+      function cleanUp() {
+        [sender, receiver].forEach((peer) => peer.net.destroy());
+      }
+
+      sender.net.on('nuclear_join', (peer) => {
+        if (peer.name === receiver.name) {
+          sender.net
+            .send({
+              target: peer.name,
+              reliable: true,
+              acknowledge: true,
+              timeout: 500,
+              type: 'oversized-message',
+              payload: Buffer.alloc(256 * 1024),
+            })
+            .then(
+              () => {
+                cleanUp();
+                fail('expected the message to be dropped rather than acknowledged');
+              },
+              () => {
+                cleanUp();
+                done();
+              },
+            );
+        }
+      });
+
+      receiver.net.on('oversized-message', () => {
+        cleanUp();
+        fail('the message was larger than the receiver accepts but it was delivered');
+      });
+
+      sender.net.connect({ name: sender.name });
+      receiver.net.connect({ name: receiver.name, maxMessageSize: 64 * 1024 });
+
+      return cleanUp;
+    },
+    { timeout: 2000 },
+  );
+});
+
 test.run();